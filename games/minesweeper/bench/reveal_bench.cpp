@@ -0,0 +1,92 @@
+#include "minesweeper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+ * Reveal throughput benchmark.
+ *
+ * For every board size a board is generated by a first click in its centre, then the same click is
+ * revealed again `iterations` times (`hide_all()` in between, not measured). Results are printed as JSON,
+ * the throughput is the revealed tiles divided by the median reveal time.
+ *
+ * reveal_bench [--density D] [--iterations N] [--size N]...
+ *
+ *   --density     Share of bomb tiles (default 0.1)
+ *   --iterations  Measured reveals per size (default 10)
+ *   --size        Board dimension, may be repeated (default 256, 1024 and 4096)
+ */
+
+struct BenchConfig
+{
+    float density = 0.1f;
+    int iterations = 10;
+    std::vector<size_t> sizes;
+};
+
+static bool parse_args(int argc, char **argv, BenchConfig &config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value != nullptr && strcmp(arg, "--density") == 0)
+            config.density = (float)atof(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--iterations") == 0)
+            config.iterations = atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--size") == 0)
+            config.sizes.push_back((size_t)atol(argv[++i]));
+        else
+            return false;
+    }
+    if (config.sizes.empty())
+        config.sizes = {256, 1024, 4096};
+    for (size_t size : config.sizes)
+        if (size < 2)
+            return false;
+    return config.iterations > 0 && config.density >= 0 && config.density < 1;
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parse_args(argc, argv, config))
+    {
+        fprintf(stderr, "usage: %s [--density 0-1] [--iterations N] [--size N]...\n", argv[0]);
+        return 1;
+    }
+
+    printf("{\n  \"density\": %.3f,\n  \"iterations\": %d,\n  \"results\": [\n", config.density, config.iterations);
+    for (size_t s = 0; s < config.sizes.size(); s++)
+    {
+        size_t size = config.sizes[s];
+        Minesweeper game(size, config.density);
+        game.upd_player_loc_mouse((int)(size / 2), (int)(size / 2));
+
+        auto start = std::chrono::steady_clock::now();
+        game.rev_sel_tile();
+        double first_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t revealed = game.count_revealed();
+
+        std::vector<double> times;
+        for (int i = 0; i < config.iterations; i++)
+        {
+            game.hide_all();
+            start = std::chrono::steady_clock::now();
+            game.rev_sel_tile();
+            times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+
+        printf("    {\"size\": %zu, \"tiles\": %zu, \"revealed\": %zu, \"first_click_ms\": %.3f, "
+               "\"reveal_ms\": %.3f, \"tiles_per_sec\": %.0f}%s\n",
+               size, size * size, revealed, first_ms, median * 1e3, revealed / median,
+               s + 1 < config.sizes.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
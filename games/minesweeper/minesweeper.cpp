@@ -1,6 +1,6 @@
 #include "minesweeper.h"
+#include <algorithm>
 #include <random>
-#include <unordered_set>
 
 Minesweeper::Minesweeper(size_t dimension, float density)
 {
@@ -11,45 +11,103 @@ Minesweeper::Minesweeper(size_t dimension, float density)
     p_loc.y = 0x0;
     mine_amount = density * (map_size);
     current_flagged = 0;
+    row_words = (map_dim + 63) / 64;
+    last_word_mask = map_dim % 64 ? (uint64_t(1) << (map_dim % 64)) - 1 : ~uint64_t(0);
 }
 
 void Minesweeper::upd_player_loc_mouse(int x, int y)
 {
-    if(x < 0 || x > 255 || y < 0 || y > 255)
+    if(x < 0 || static_cast<size_t>(x) >= map_dim || y < 0 || static_cast<size_t>(y) >= map_dim)
         return;
-    p_loc.x = static_cast<uint8_t>(x);
-    p_loc.y = static_cast<uint8_t>(y);
+    p_loc.x = static_cast<size_t>(x);
+    p_loc.y = static_cast<size_t>(y);
 }
 
-void Minesweeper::gen_map()
+//The first clicked tile never holds a bomb
+void Minesweeper::gen_map(size_t safe_pos)
 {
     is_first_click = false;
-    //Random number generation (for bombs)
+    if (mine_amount > map_size - 1)
+        mine_amount = map_size - 1;
+    bombs.assign(map_dim * row_words, 0);
+    flags.assign(map_dim * row_words, 0);
+    revealed.assign(map_dim * row_words, 0);
+
+    //Random number generation (for bombs), the plane itself rejects duplicates
     std::random_device rand_seed;
     std::mt19937 rand_gen(rand_seed());
-    std::uniform_int_distribution<int> rand_range(0, map_size);
-    //Ensure no duplicates
-    std::unordered_set<int> unique_num;
-    while (unique_num.size() < mine_amount)
+    std::uniform_int_distribution<size_t> rand_range(0, map_size - 1);
+    size_t placed = 0;
+    while (placed < mine_amount)
     {
-        int rand_num = rand_range(rand_gen);
-        unique_num.insert(rand_num);
+        size_t rand_num = rand_range(rand_gen);
+        size_t bit = bit_pos(rand_num);
+        if (rand_num == safe_pos || test(bombs, bit))
+            continue;
+        bombs[bit / 64] |= uint64_t(1) << (bit % 64);
+        placed++;
     }
-    
-    //Fill squares in map
-    ms_tile_info tile {0, 0, 0, 0, 0};
-    for (int i = 0; i < map_size; i++)
+    count_neighbours();
+}
+
+//Moves bit i of an 8 bit value to bit 4 * i
+static inline uint32_t spread_nibbles(uint32_t x)
+{
+    x = (x | x << 12) & 0x000F000F;
+    x = (x | x << 6) & 0x03030303;
+    return (x | x << 3) & 0x11111111;
+}
+
+//Counts all neighbours of 64 tiles at once: the 8 neighbour planes are summed with bit sliced
+//full adders (carry save), giving the count as 4 planes (bit 0 to bit 3 of every tile's count)
+void Minesweeper::count_neighbours()
+{
+    counts.assign(map_dim * row_words * 8, 0);
+    const std::vector<uint64_t> empty_row(row_words, 0);
+    for (size_t row = 0; row < map_dim; row++)
     {
-        map.push_back(tile);
-        tile.id++;
+        const uint64_t *above = row > 0 ? &bombs[(row - 1) * row_words] : empty_row.data();
+        const uint64_t *mid = &bombs[row * row_words];
+        const uint64_t *below = row + 1 < map_dim ? &bombs[(row + 1) * row_words] : empty_row.data();
+        uint32_t *out = &counts[row * row_words * 8];
+        for (size_t w = 0; w < row_words; w++)
+        {
+            //West neighbours shift up one column, east ones down, across word boundaries
+            uint64_t n[8];
+            const uint64_t *rows[3] = {above, mid, below};
+            int k = 0;
+            for (int r = 0; r < 3; r++)
+            {
+                uint64_t prev = w > 0 ? rows[r][w - 1] : 0;
+                uint64_t next = w + 1 < row_words ? rows[r][w + 1] : 0;
+                n[k++] = rows[r][w] << 1 | prev >> 63;
+                n[k++] = rows[r][w] >> 1 | next << 63;
+                if (r != 1)
+                    n[k++] = rows[r][w];
+            }
+            //Weight 1: three full adders and a half adder
+            uint64_t s0 = n[0] ^ n[1] ^ n[2], k0 = (n[0] & n[1]) | (n[2] & (n[0] ^ n[1]));
+            uint64_t s1 = n[3] ^ n[4] ^ n[5], k1 = (n[3] & n[4]) | (n[5] & (n[3] ^ n[4]));
+            uint64_t s2 = n[6] ^ n[7], k2 = n[6] & n[7];
+            uint64_t bit0 = s0 ^ s1 ^ s2, k3 = (s0 & s1) | (s2 & (s0 ^ s1));
+            //Weight 2 and 4
+            uint64_t t = k0 ^ k1 ^ k2, u = (k0 & k1) | (k2 & (k0 ^ k1));
+            uint64_t bit1 = t ^ k3, v = t & k3;
+            uint64_t bit2 = u ^ v, bit3 = u & v;
+            //Transpose into 4 bit counts, 8 tiles per word
+            for (int b = 0; b < 8; b++)
+            {
+                int shift = b * 8;
+                out[w * 8 + b] = spread_nibbles((bit0 >> shift) & 0xFF)
+                               | spread_nibbles((bit1 >> shift) & 0xFF) << 1
+                               | spread_nibbles((bit2 >> shift) & 0xFF) << 2
+                               | spread_nibbles((bit3 >> shift) & 0xFF) << 3;
+            }
+        }
     }
-
-    //Set generated bomb tiles
-    for (const auto& bomb_id : unique_num)
-        map[bomb_id].is_bomb = 0x1;
 }
 
-int Minesweeper::edgecase_check(uint16_t map_pos)
+int Minesweeper::edgecase_check(size_t map_pos)
 {
     int temp = 0;
     if (map_pos % map_dim == 0) 
@@ -76,95 +134,127 @@ int Minesweeper::edgecase_check(uint16_t map_pos)
     return temp;
 }
 
-//Average code block moment
-void Minesweeper::rev_sel_tile_recurse(uint16_t p_map_pos)
+size_t Minesweeper::bit_pos(size_t map_pos) const
+{
+    return (map_pos / map_dim) * row_words * 64 + map_pos % map_dim;
+}
+
+bool Minesweeper::test(const std::vector<uint64_t> &plane, size_t bit) const
+{
+    return (plane[bit / 64] >> (bit % 64)) & 1;
+}
+
+//Tiles the reveal does not spread over (revealed, bombs, flagged and the row padding)
+uint64_t Minesweeper::blocked_word(size_t row, size_t word) const
+{
+    size_t i = row * row_words + word;
+    uint64_t blocked = revealed[i] | bombs[i] | flags[i];
+    if (word == row_words - 1)
+        blocked |= ~last_word_mask;
+    return blocked;
+}
+
+//Pushes one seed per run of open tiles in columns [first, end) of a row
+void Minesweeper::push_row_seeds(size_t row, size_t first, size_t end)
 {
-    map[p_map_pos].is_rev = 1;
-    switch(edgecase_check(p_map_pos))
+    uint64_t carry = 0; //Whether the column before the current word is open
+    for (size_t w = first / 64; w * 64 < end; w++)
     {
-        case 0: //none
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos));           
-            break;
-        case 1: //left
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos));  
-            break;
-        case 2: //right
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            break;
-        case 3: //top
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos)); 
-            break;
-        case 4: //down
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos));   
-            break;
-        case 5: //top left
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos)); 
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            break;
-        case 6: //bottom right
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            break;
-        case 7: //bottom left
-            if (!map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_ABOVE(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_ABOVE(p_map_pos));
-            if (!map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_RIGHT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_RIGHT(p_map_pos)); 
-            break;
-        case 8: //top right
-            if (!map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_DOWN(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_DOWN(p_map_pos));
-            if (!map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_rev && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_bomb && !map[MINESWEEPER_TILE_LEFT(p_map_pos)].is_flag)
-                rev_sel_tile_recurse(MINESWEEPER_TILE_LEFT(p_map_pos));
-            break;
+        uint64_t range = ~uint64_t(0);
+        if (w == first / 64)
+            range &= ~uint64_t(0) << (first % 64);
+        if (end < (w + 1) * 64)
+            range &= (uint64_t(1) << (end % 64)) - 1;
+        uint64_t open = ~blocked_word(row, w) & range;
+        uint64_t starts = open & ~(open << 1 | carry);
+        carry = open >> 63;
+        while (starts)
+        {
+            fill_seeds.push_back((row * row_words + w) * 64 + __builtin_ctzll(starts));
+            starts &= starts - 1;
+        }
+    }
+}
+
+//Scanline fill: reveals a whole row span per seed, then seeds the spans above and below it.
+//Spans are found and revealed a word (64 tiles) at a time and no recursion is involved
+void Minesweeper::rev_sel_tile_fill(size_t p_map_pos)
+{
+    size_t row_bits = row_words * 64;
+    size_t start = bit_pos(p_map_pos);
+    size_t start_row = start / row_bits;
+    size_t start_col = start % row_bits;
+    fill_seeds.clear();
+    if (!(blocked_word(start_row, start_col / 64) >> (start_col % 64) & 1))
+        fill_seeds.push_back(start);
+    else
+    {
+        //The selected tile itself is revealed even if it is flagged, the fill starts next to it
+        revealed[start / 64] |= uint64_t(1) << (start % 64);
+        if (start_row > 0)
+            push_row_seeds(start_row - 1, start_col, start_col + 1);
+        if (start_row + 1 < map_dim)
+            push_row_seeds(start_row + 1, start_col, start_col + 1);
+        if (start_col > 0)
+            push_row_seeds(start_row, start_col - 1, start_col);
+        if (start_col + 1 < map_dim)
+            push_row_seeds(start_row, start_col + 1, start_col + 2);
+    }
+
+    while (!fill_seeds.empty())
+    {
+        size_t bit = fill_seeds.back();
+        fill_seeds.pop_back();
+        size_t row = bit / row_bits;
+        size_t col = bit % row_bits;
+        size_t w = col / 64;
+        if (blocked_word(row, w) >> (col % 64) & 1)
+            continue; //Revealed by an earlier span
+
+        //Nearest blocked tile on the left
+        uint64_t m = blocked_word(row, w) & ((uint64_t(1) << (col % 64)) - 1);
+        while (!m && w > 0)
+            m = blocked_word(row, --w);
+        size_t left = m ? w * 64 + 64 - __builtin_clzll(m) : 0;
+        //And on the right, the row padding always ends the span
+        w = col / 64;
+        m = blocked_word(row, w) & ~((uint64_t(2) << (col % 64)) - 1);
+        while (!m && w + 1 < row_words)
+            m = blocked_word(row, ++w);
+        size_t end = m ? w * 64 + __builtin_ctzll(m) : row_bits;
+
+        for (size_t i = left / 64; i * 64 < end; i++)
+        {
+            uint64_t range = ~uint64_t(0);
+            if (i == left / 64)
+                range &= ~uint64_t(0) << (left % 64);
+            if (end < (i + 1) * 64)
+                range &= (uint64_t(1) << (end % 64)) - 1;
+            revealed[row * row_words + i] |= range;
+        }
+        if (row > 0)
+            push_row_seeds(row - 1, left, end);
+        if (row + 1 < map_dim)
+            push_row_seeds(row + 1, left, end);
     }
-    
 }
 
 //Returns false if alive and true if died
 bool Minesweeper::rev_sel_tile()
 {
+    //Begin reveal
+    if (is_first_click)
+        Minesweeper::gen_map(MINESWEEPER_P_TO_MAP_TRANSFER);
+
     //Lose condition
-    if (map[MINESWEEPER_P_TO_MAP_TRANSFER].is_bomb && !map[MINESWEEPER_P_TO_MAP_TRANSFER].is_flag)
+    size_t bit = bit_pos(MINESWEEPER_P_TO_MAP_TRANSFER);
+    if (test(bombs, bit) && !test(flags, bit))
         return true;
     
-    //Begin reveal
-    if (is_first_click)
-        Minesweeper::gen_map();
-    rev_sel_tile_recurse(MINESWEEPER_P_TO_MAP_TRANSFER);
+    rev_sel_tile_fill(MINESWEEPER_P_TO_MAP_TRANSFER);
     return false;
 }
+
 //Up = 0, Down = 1, Left = 2, Right = 3
 void Minesweeper::upd_player_loc_kbd(int direction)
 {
@@ -229,24 +319,33 @@ void Minesweeper::kbd_loc_upd_logic(int direction)
 
 void Minesweeper::flag_sel_tile()
 {
-    uint16_t p_map_pos = MINESWEEPER_P_TO_MAP_TRANSFER;
-    if (!map[p_map_pos].is_flag)
+    //Nothing to flag before the map exists
+    if (is_first_click)
+        return;
+    size_t bit = bit_pos(MINESWEEPER_P_TO_MAP_TRANSFER);
+    uint64_t mask = uint64_t(1) << (bit % 64);
+    if (!test(flags, bit))
     {
-        if (map[p_map_pos].is_rev)
+        if (test(revealed, bit))
             return;
-        if (map[p_map_pos].is_bomb)
+        if (test(bombs, bit))
         {
-            map[p_map_pos].is_flag = 1;
+            flags[bit / 64] |= mask;
             current_flagged++;
         }
     } else 
     {
-        if (map[p_map_pos].is_bomb)
+        if (test(bombs, bit))
             current_flagged--;
-        map[p_map_pos].is_flag = 0;
+        flags[bit / 64] &= ~mask;
     }
 }
 
+void Minesweeper::hide_all()
+{
+    std::fill(revealed.begin(), revealed.end(), 0);
+}
+
 bool Minesweeper::did_win()
 {
     if (current_flagged == mine_amount)
@@ -254,7 +353,28 @@ bool Minesweeper::did_win()
     return false;
 }
 
-const std::vector<ms_tile_info>& Minesweeper::get_map()
+ms_tile_info Minesweeper::get_tile(size_t x, size_t y) const
+{
+    ms_tile_info tile {0, 0, 0, 0, static_cast<uint32_t>(map_dim * y + x)};
+    if (is_first_click || x >= map_dim || y >= map_dim)
+        return tile;
+    size_t bit = y * row_words * 64 + x;
+    tile.is_flag = test(flags, bit);
+    tile.is_bomb = test(bombs, bit);
+    tile.is_rev = test(revealed, bit);
+    tile.num = (counts[y * row_words * 8 + x / 8] >> (x % 8 * 4)) & 0xF;
+    return tile;
+}
+
+size_t Minesweeper::get_dim() const
 {
-    return map;
-}
\ No newline at end of file
+    return map_dim;
+}
+
+size_t Minesweeper::count_revealed() const
+{
+    size_t total = 0;
+    for (uint64_t word : revealed)
+        total += __builtin_popcountll(word);
+    return total;
+}
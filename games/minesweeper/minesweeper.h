@@ -1,21 +1,22 @@
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
-//Stores player location in hex digits (0 indexed)
+//Stores player location in tiles (0 indexed)
 struct ms_player_loc
 {
-    uint8_t x;
-    uint8_t y;
+    size_t x;
+    size_t y;
 };
 
-//Store critical tile information
+//Store critical tile information, assembled from the board planes by `get_tile()`
 struct ms_tile_info
 {
     uint8_t is_flag;
     uint8_t is_bomb;
     uint8_t is_rev;
     uint8_t num;
-    uint16_t id;
+    uint32_t id;
 };
 
 #define MINESWEEPER_P_TO_MAP_TRANSFER (map_dim * p_loc.y) + p_loc.x //0 indexed
@@ -28,16 +29,30 @@ struct ms_tile_info
 class Minesweeper
 {
     private:
-        std::vector<ms_tile_info> map; //2d map represented in linear vector
+        //Bit planes, one bit per tile, every row starts on a new 64 bit word (row_words per row).
+        //The padding bits past map_dim stay 0
+        std::vector<uint64_t> bombs;
+        std::vector<uint64_t> flags;
+        std::vector<uint64_t> revealed;
+        //Neighbouring bomb count per tile, 4 bits each, 8 tiles per word, rows padded like the planes
+        std::vector<uint32_t> counts;
+        size_t row_words;
+        uint64_t last_word_mask; //Tiles in use in the last word of a row
         ms_player_loc p_loc; 
         size_t map_size;
         size_t map_dim;
         size_t mine_amount;
         size_t current_flagged;
         bool is_first_click;
-        void gen_map();
-        int edgecase_check(uint16_t map_pos);
-        void rev_sel_tile_recurse(uint16_t p_map_pos);
+        std::vector<size_t> fill_seeds; //Work stack of the reveal (bit positions), kept between reveals
+        void gen_map(size_t safe_pos);
+        void count_neighbours();
+        int edgecase_check(size_t map_pos);
+        size_t bit_pos(size_t map_pos) const;
+        bool test(const std::vector<uint64_t> &plane, size_t bit) const;
+        uint64_t blocked_word(size_t row, size_t word) const;
+        void push_row_seeds(size_t row, size_t first, size_t end);
+        void rev_sel_tile_fill(size_t p_map_pos);
         void kbd_loc_upd_logic(int direction);
         //mode bool
     public:
@@ -46,6 +61,9 @@ class Minesweeper
         void upd_player_loc_kbd(int direction); //0 indexed
         bool rev_sel_tile(); //0 indexed
         void flag_sel_tile(); //0 indexed
+        void hide_all(); //Hides every tile again, the mines stay
         bool did_win();
-        const std::vector<ms_tile_info>& get_map();
+        ms_tile_info get_tile(size_t x, size_t y) const; //0 indexed
+        size_t get_dim() const;
+        size_t count_revealed() const;
 };
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "chassis_board.h"
+#include "chassis_clock.h"
+#include "chassis_mock_board.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Round trip benchmark of the chassis interfaces.
+ *
+ * One cycle is a control write followed by a status read (a status read only for the sensors).
+ * Every interface is measured alone and with all three running at the same time, once with the
+ * blocking calls and once pipelined through the asynchronous engine. Results are printed as JSON.
+ *
+ * chassis_bench [--hw] [--iterations N] [--warmup N] [--depth N] [--latency-us N] [--jitter-us N] [--out FILE]
+ *
+ *   --hw          Run against the real board instead of the simulated one
+ *   --iterations  Measured cycles per case (default 5000)
+ *   --warmup      Unmeasured cycles before each case (default 200)
+ *   --depth       Cycles kept in flight in the asynchronous modes (default 4)
+ *   --latency-us  Simulated transfer latency (default 125)
+ *   --jitter-us   Simulated latency jitter (default 25)
+ *   --out         Writes the JSON to FILE instead of stdout
+ */
+
+enum BenchIface
+{
+    eBenchDrive,
+    eBenchServo,
+    eBenchSensor
+};
+
+enum BenchMode
+{
+    eBenchBlocking,
+    eBenchAsync,
+    eBenchBatch //Drive only, four motor commands per cycle through write_batch()
+};
+
+struct BenchConfig
+{
+    bool hardware = false;
+    int iterations = 5000;
+    int warmup = 200;
+    int depth = 4;
+    uint32_t latency_us = 125;
+    uint32_t jitter_us = 25;
+    const char *out = nullptr;
+};
+
+struct BenchResult
+{
+    std::string name;
+    BenchMode mode;
+    bool concurrent;
+    uint64_t cycles = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+    std::vector<uint64_t> latency_ns;
+};
+
+static const char *iface_name(BenchIface iface)
+{
+    switch (iface)
+    {
+        case eBenchDrive: return "drive";
+        case eBenchServo: return "servo";
+        default: return "sensor";
+    }
+}
+
+static const char *mode_name(BenchMode mode)
+{
+    switch (mode)
+    {
+        case eBenchBlocking: return "blocking";
+        case eBenchAsync: return "async";
+        default: return "batch";
+    }
+}
+
+//Fills the control packet of an interface with a command that changes every cycle
+static void set_command(ChassisBoard &chassis, BenchIface iface, int cycle)
+{
+#ifndef CHASSIS_RMV_EZ_MODE
+    if (iface == eBenchDrive)
+    {
+        chassis.DrvMtr.set_ID((eDrvMotors)(cycle % eN_DrvMotor));
+        chassis.DrvMtr.set_Vel((float)(cycle % 100));
+        chassis.DrvMtr.set_ActiveStatus(true);
+    }
+    else if (iface == eBenchServo)
+    {
+        chassis.servos.set_ID((eChassisServo)(cycle % eN_Servo));
+        chassis.servos.set_CTRL(cycle);
+    }
+#else
+    (void)chassis;
+    (void)iface;
+    (void)cycle;
+#endif
+}
+
+static libusb_error run_blocking_cycle(ChassisBoard &chassis, BenchIface iface, int cycle)
+{
+    set_command(chassis, iface, cycle);
+    libusb_error err = LIBUSB_SUCCESS;
+    if (iface == eBenchDrive)
+        err = chassis.DrvMtr.write();
+    else if (iface == eBenchServo)
+        err = chassis.servos.write();
+    if (err != LIBUSB_SUCCESS)
+        return err;
+    if (iface == eBenchDrive)
+        return chassis.DrvMtr.read();
+    if (iface == eBenchServo)
+        return chassis.servos.read();
+    return chassis.sensors.read();
+}
+
+//Keeps up to `depth` cycles in flight
+class BenchWindow
+{
+    public:
+        explicit BenchWindow(int depth) : depth(depth) {}
+
+        void acquire()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cv.wait(guard, [this]() { return in_flight < depth; });
+            in_flight++;
+        }
+
+        void release()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            in_flight--;
+            cv.notify_all();
+        }
+
+        void drain()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cv.wait(guard, [this]() { return in_flight == 0; });
+        }
+
+    private:
+        std::mutex lock;
+        std::condition_variable cv;
+        int depth;
+        int in_flight = 0;
+};
+
+//Submits a request, retrying while the endpoint queue is full
+template <typename Submit>
+static libusb_error submit_retry(Submit submit)
+{
+    libusb_error err;
+    while ((err = submit()) == LIBUSB_ERROR_BUSY)
+        std::this_thread::yield();
+    return err;
+}
+
+//Completion state of one asynchronous cycle, the cycle ends when its write and its read are both done
+struct BenchCycle
+{
+    std::atomic<int> remaining;
+    uint64_t start_ns;
+    uint64_t *latency_ns;
+};
+
+static void run_async_cycles(ChassisBoard &chassis, BenchIface iface, BenchMode mode, int count, BenchWindow &window, BenchResult &result, bool measure)
+{
+    std::atomic<uint64_t> errors{0};
+    for (int cycle = 0; cycle < count; cycle++)
+    {
+        window.acquire();
+        auto state = std::make_shared<BenchCycle>();
+        state->remaining = iface == eBenchSensor ? 1 : 2;
+        state->start_ns = cb_now_ns();
+        state->latency_ns = measure ? &result.latency_ns[cycle] : nullptr;
+        auto done = [&window, &errors, state](libusb_error err) {
+            if (err != LIBUSB_SUCCESS)
+                errors.fetch_add(1, std::memory_order_relaxed);
+            if (--state->remaining != 0)
+                return;
+            if (state->latency_ns != nullptr)
+                *state->latency_ns = cb_now_ns() - state->start_ns;
+            window.release();
+        };
+
+        libusb_error err = LIBUSB_SUCCESS;
+        set_command(chassis, iface, cycle);
+        if (mode == eBenchBatch)
+        {
+            udev_mtr_ctrl setpoints[eN_DrvMotor] = {};
+            for (int i = 0; i < eN_DrvMotor; i++)
+            {
+                setpoints[i].enable = 1;
+                setpoints[i].velocity = (float)((cycle + i) % 100);
+            }
+            //A rejected batch may be partially sent, so it is reported instead of retried
+            chassis.DrvMtr.write_batch(setpoints, [done](const CBDriveBatchResults &results) {
+                libusb_error batch_err = LIBUSB_SUCCESS;
+                for (libusb_error motor_err : results)
+                    if (motor_err != LIBUSB_SUCCESS)
+                        batch_err = motor_err;
+                done(batch_err);
+            });
+        }
+        else if (iface == eBenchDrive)
+        {
+            err = submit_retry([&]() { return chassis.DrvMtr.write_async(done); });
+            if (err != LIBUSB_SUCCESS)
+                done(err);
+        }
+        else if (iface == eBenchServo)
+        {
+            err = submit_retry([&]() { return chassis.servos.write_async(done); });
+            if (err != LIBUSB_SUCCESS)
+                done(err);
+        }
+
+        if (iface == eBenchDrive)
+            err = submit_retry([&]() { return chassis.DrvMtr.read_async(done); });
+        else if (iface == eBenchServo)
+            err = submit_retry([&]() { return chassis.servos.read_async(done); });
+        else
+            err = submit_retry([&]() { return chassis.sensors.read_async(done); });
+        if (err != LIBUSB_SUCCESS)
+            done(err);
+    }
+    window.drain();
+    if (measure)
+        result.errors += errors.load();
+}
+
+static void run_case(ChassisBoard &chassis, BenchIface iface, BenchMode mode, const BenchConfig &config, BenchResult &result)
+{
+    result.latency_ns.assign(config.iterations, 0);
+    if (mode == eBenchBlocking)
+    {
+        for (int cycle = 0; cycle < config.warmup; cycle++)
+            run_blocking_cycle(chassis, iface, cycle);
+        uint64_t begin_ns = cb_now_ns();
+        for (int cycle = 0; cycle < config.iterations; cycle++)
+        {
+            uint64_t start_ns = cb_now_ns();
+            if (run_blocking_cycle(chassis, iface, cycle) != LIBUSB_SUCCESS)
+                result.errors++;
+            result.latency_ns[cycle] = cb_now_ns() - start_ns;
+        }
+        result.seconds = (cb_now_ns() - begin_ns) * 1e-9;
+    }
+    else
+    {
+        //A batch takes one queue entry per motor on the drive endpoint
+        int depth = mode == eBenchBatch ? std::max(1, config.depth / eN_DrvMotor) : config.depth;
+        BenchWindow window(depth);
+        run_async_cycles(chassis, iface, mode, config.warmup, window, result, false);
+        uint64_t begin_ns = cb_now_ns();
+        run_async_cycles(chassis, iface, mode, config.iterations, window, result, true);
+        result.seconds = (cb_now_ns() - begin_ns) * 1e-9;
+    }
+    result.cycles = config.iterations;
+}
+
+//Runs the drive, servo and sensor cases, alone or all three at once on separate threads
+static void run_suite(ChassisBoard &chassis, BenchMode mode, bool concurrent, const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    const BenchIface ifaces[] = {eBenchDrive, eBenchServo, eBenchSensor};
+    BenchMode modes[3];
+    std::vector<BenchResult> suite(3);
+    for (int i = 0; i < 3; i++)
+    {
+        //Batch mode only changes how the drive commands are sent
+        modes[i] = mode == eBenchBatch && ifaces[i] != eBenchDrive ? eBenchAsync : mode;
+        suite[i].name = iface_name(ifaces[i]);
+        suite[i].mode = modes[i];
+        suite[i].concurrent = concurrent;
+    }
+
+    if (!concurrent)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (mode == eBenchBatch && ifaces[i] != eBenchDrive)
+                continue;
+            run_case(chassis, ifaces[i], modes[i], config, suite[i]);
+            results.push_back(std::move(suite[i]));
+        }
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; i++)
+        workers.emplace_back([&, i]() { run_case(chassis, ifaces[i], modes[i], config, suite[i]); });
+    for (std::thread &worker : workers)
+        worker.join();
+    for (BenchResult &result : suite)
+        results.push_back(std::move(result));
+}
+
+static double percentile_us(const std::vector<uint64_t> &sorted, double pct)
+{
+    if (sorted.empty())
+        return 0;
+    size_t rank = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)] * 1e-3;
+}
+
+static void write_json(FILE *out, const BenchConfig &config, std::vector<BenchResult> &results)
+{
+    fprintf(out, "{\n  \"transport\": \"%s\",\n  \"iterations\": %d,\n  \"warmup\": %d,\n  \"depth\": %d,\n",
+            config.hardware ? "libusb" : "mock", config.iterations, config.warmup, config.depth);
+    if (!config.hardware)
+        fprintf(out, "  \"mock_latency_us\": %u,\n  \"mock_jitter_us\": %u,\n", config.latency_us, config.jitter_us);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        BenchResult &result = results[i];
+        std::sort(result.latency_ns.begin(), result.latency_ns.end());
+        double rate = result.seconds > 0 ? result.cycles / result.seconds : 0;
+        fprintf(out, "    {\"interface\": \"%s\", \"mode\": \"%s\", \"concurrent\": %s, \"cycles\": %lu, \"errors\": %lu, "
+                     "\"seconds\": %.6f, \"cycles_per_sec\": %.1f, "
+                     "\"latency_us\": {\"min\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p99_9\": %.3f, \"max\": %.3f}}%s\n",
+                result.name.c_str(), mode_name(result.mode), result.concurrent ? "true" : "false",
+                (unsigned long)result.cycles, (unsigned long)result.errors, result.seconds, rate,
+                percentile_us(result.latency_ns, 0), percentile_us(result.latency_ns, 50), percentile_us(result.latency_ns, 99),
+                percentile_us(result.latency_ns, 99.9), percentile_us(result.latency_ns, 100),
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static bool parse_args(int argc, char **argv, BenchConfig &config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--hw") == 0)
+            config.hardware = true;
+        else if (value != nullptr && strcmp(arg, "--iterations") == 0)
+            config.iterations = atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--warmup") == 0)
+            config.warmup = atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--depth") == 0)
+            config.depth = atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--latency-us") == 0)
+            config.latency_us = (uint32_t)atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--jitter-us") == 0)
+            config.jitter_us = (uint32_t)atoi(argv[++i]);
+        else if (value != nullptr && strcmp(arg, "--out") == 0)
+            config.out = argv[++i];
+        else
+            return false;
+    }
+    return config.iterations > 0 && config.warmup >= 0 && config.depth >= 1 && config.depth <= ChassisAsyncEngine::max_queue_depth;
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parse_args(argc, argv, config))
+    {
+        fprintf(stderr, "usage: %s [--hw] [--iterations N] [--warmup N] [--depth 1-%d] [--latency-us N] [--jitter-us N] [--out FILE]\n",
+                argv[0], ChassisAsyncEngine::max_queue_depth);
+        return 2;
+    }
+
+    CBMockConfig mock_config;
+    mock_config.latency_us = config.latency_us;
+    mock_config.jitter_us = config.jitter_us;
+    ChassisMockBoard mock(mock_config);
+    std::unique_ptr<ChassisBoard> chassis = config.hardware ? std::make_unique<ChassisBoard>() : std::make_unique<ChassisBoard>(mock);
+
+    libusb_error err = chassis->initialize(LIBUSB_LOG_LEVEL_NONE);
+    if (err == LIBUSB_SUCCESS)
+        err = chassis->claimInterfaces();
+    if (err == LIBUSB_SUCCESS)
+        err = chassis->start_async(config.depth);
+    if (err != LIBUSB_SUCCESS)
+    {
+        fprintf(stderr, "chassis setup failed: %s\n", libusb_error_name(err));
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (BenchMode mode : {eBenchBlocking, eBenchAsync, eBenchBatch})
+    {
+        run_suite(*chassis, mode, false, config, results);
+        run_suite(*chassis, mode, true, config, results);
+    }
+
+    FILE *out = config.out != nullptr ? fopen(config.out, "w") : stdout;
+    if (out == nullptr)
+    {
+        perror(config.out);
+        return 1;
+    }
+    write_json(out, config, results);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
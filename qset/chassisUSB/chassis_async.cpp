@@ -0,0 +1,387 @@
+#include "chassis_async.h"
+#include "chassis_clock.h"
+#include <chrono>
+#include <cstring>
+
+//Endpoints serviced by the engine (SENS_* currently aliases SRVO_*, duplicates are skipped)
+static constexpr uint8_t data_endpoints[] = {
+    DRVM_RXD_EP, DRVM_TXD_EP, DRVM_NTF_EP,
+    SRVO_RXD_EP, SRVO_TXD_EP, SRVO_NTF_EP,
+    SENS_RXD_EP, SENS_TXD_EP, SENS_NTF_EP
+};
+
+//Set on the engine's event thread and while a completion runs (also on a manager's event thread)
+static thread_local bool in_event_thread = false;
+
+bool ChassisAsyncEngine::on_event_thread()
+{
+    return in_event_thread;
+}
+
+ChassisAsyncEngine::~ChassisAsyncEngine()
+{
+    stop();
+}
+
+int ChassisAsyncEngine::ep_index(uint8_t endpoint)
+{
+    return (endpoint & 0x0F) | ((endpoint & LIBUSB_ENDPOINT_IN) ? 0x10 : 0x00);
+}
+
+eCBQosClass ChassisAsyncEngine::qos_class(uint8_t endpoint)
+{
+    if (endpoint == DRVM_RXD_EP)
+        return eCBQosDrive;
+    if (endpoint == SRVO_RXD_EP)
+        return eCBQosServo;
+    return eCBQosTelemetry;
+}
+
+libusb_error ChassisAsyncEngine::start(ChassisTransport *transport, int queue_depth, bool device_memory)
+{
+    if (running)
+        return LIBUSB_ERROR_BUSY;
+    if (transport == nullptr || queue_depth < 1 || queue_depth > max_queue_depth)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    this->transport = transport;
+
+    size_t n_pools = 0;
+    bool used[n_endpoints] = {};
+    for (uint8_t endpoint : data_endpoints)
+    {
+        if (!used[ep_index(endpoint)])
+            n_pools++;
+        used[ep_index(endpoint)] = true;
+    }
+
+    //One buffer per slot plus the spare
+    size_t n_slots = n_pools * queue_depth;
+    buffers = transport->alloc_buffers((n_slots + 1) * buffer_stride, device_memory);
+    if (buffers.data == nullptr)
+        return LIBUSB_ERROR_NO_MEM;
+    spare = buffers.data + n_slots * buffer_stride;
+
+    //Slots are never resized after this point, pools keep raw pointers into the vector
+    slots.resize(n_slots);
+    size_t next = 0;
+    for (uint8_t endpoint : data_endpoints)
+    {
+        CBEndpointPool &pool = pools[ep_index(endpoint)];
+        if (!pool.idle.empty())
+            continue;
+        for (int i = 0; i < queue_depth; i++)
+        {
+            CBTransferSlot &slot = slots[next];
+            slot.engine = this;
+            slot.request.endpoint = endpoint;
+            slot.request.buffer = buffers.data + next * buffer_stride;
+            next++;
+            slot.request.on_complete = &ChassisAsyncEngine::transfer_cb;
+            slot.request.user_data = &slot;
+            slot.qos.user_data = &slot;
+            libusb_error err = transport->prepare(&slot.request);
+            if (err != LIBUSB_SUCCESS)
+            {
+                free_slots();
+                return err;
+            }
+            pool.idle.push_back(&slot);
+        }
+        pool.busy.reserve(queue_depth);
+    }
+
+    running = true;
+    if (!transport->shared_events())
+        event_thread = std::thread(&ChassisAsyncEngine::event_loop, this);
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisAsyncEngine::stop()
+{
+    //The drain below waits for the event thread, which would be waiting for itself
+    if (in_event_thread)
+        return LIBUSB_ERROR_BUSY;
+    if (!running.exchange(false))
+        return LIBUSB_SUCCESS;
+    for (CBEndpointPool &pool : pools)
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        for (CBTransferSlot *slot : pool.busy)
+            cancel_slot(slot);
+    }
+    dispatch();
+    if (event_thread.joinable())
+    {
+        transport->wake();
+        event_thread.join();
+    }
+    else
+    {
+        //The shared event thread delivers the cancellations
+        while (in_flight > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    free_slots();
+    return LIBUSB_SUCCESS;
+}
+
+bool ChassisAsyncEngine::is_running() const
+{
+    return running;
+}
+
+int ChassisAsyncEngine::get_in_flight() const
+{
+    return in_flight;
+}
+
+bool ChassisAsyncEngine::uses_device_memory() const
+{
+    return running && buffers.backend != nullptr;
+}
+
+void ChassisAsyncEngine::set_qos(const CBQosConfig &config)
+{
+    qos.configure(config);
+    //Lifting the bound lets the queued transfers go
+    dispatch();
+}
+
+CBQosConfig ChassisAsyncEngine::get_qos()
+{
+    return qos.get_config();
+}
+
+bool ChassisAsyncEngine::qos_enabled() const
+{
+    return qos.enabled();
+}
+
+CBQosStats ChassisAsyncEngine::get_qos_stats()
+{
+    return qos.get_stats();
+}
+
+libusb_error ChassisAsyncEngine::submit_out(uint8_t endpoint, const void *data, int length, unsigned int timeout, CBCompletion callback,
+                                            CBTransferTicket *ticket)
+{
+    if ((endpoint & LIBUSB_ENDPOINT_IN) || data == nullptr)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    return submit(endpoint, LIBUSB_TRANSFER_TYPE_BULK, data, length, timeout, std::move(callback), ticket);
+}
+
+libusb_error ChassisAsyncEngine::submit_in(uint8_t endpoint, int length, unsigned int timeout, CBCompletion callback,
+                                           CBTransferTicket *ticket)
+{
+    if (!(endpoint & LIBUSB_ENDPOINT_IN))
+        return LIBUSB_ERROR_INVALID_PARAM;
+    return submit(endpoint, LIBUSB_TRANSFER_TYPE_BULK, nullptr, length, timeout, std::move(callback), ticket);
+}
+
+libusb_error ChassisAsyncEngine::submit_interrupt_in(uint8_t endpoint, int length, unsigned int timeout, CBCompletion callback)
+{
+    if (!(endpoint & LIBUSB_ENDPOINT_IN))
+        return LIBUSB_ERROR_INVALID_PARAM;
+    return submit(endpoint, LIBUSB_TRANSFER_TYPE_INTERRUPT, nullptr, length, timeout, std::move(callback));
+}
+
+void ChassisAsyncEngine::cancel(uint8_t endpoint)
+{
+    {
+        CBEndpointPool &pool = pools[ep_index(endpoint)];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        for (CBTransferSlot *slot : pool.busy)
+            cancel_slot(slot);
+    }
+    dispatch();
+}
+
+void ChassisAsyncEngine::cancel(const CBTransferTicket &ticket)
+{
+    if (ticket.slot == nullptr)
+        return;
+    {
+        CBEndpointPool &pool = pools[ep_index(ticket.endpoint)];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        //Only a busy slot still running the same submission, the slot may have been reused since
+        for (CBTransferSlot *slot : pool.busy)
+            if (slot == ticket.slot && slot->serial == ticket.serial)
+                cancel_slot(slot);
+    }
+    dispatch();
+}
+
+void ChassisAsyncEngine::cancel_slot(CBTransferSlot *slot)
+{
+    //A queued transfer is completed by dispatch() without reaching the bus
+    if (!qos.cancel(&slot->qos))
+        transport->cancel(&slot->request);
+}
+
+libusb_error ChassisAsyncEngine::dispatch(CBTransferSlot *own)
+{
+    libusb_error own_err = LIBUSB_SUCCESS;
+    if (qos.idle())
+        return own_err;
+    while (ChassisQosScheduler::CBQosItem *item = qos.pop(cb_now_ns()))
+    {
+        CBTransferSlot *slot = static_cast<CBTransferSlot*>(item->user_data);
+        //Cancelled while queued, it never goes on the bus
+        if (item->cancelled)
+        {
+            transport->complete_later(&slot->request, LIBUSB_ERROR_INTERRUPTED);
+            continue;
+        }
+        libusb_error err = transport->submit(&slot->request);
+        if (err >= LIBUSB_SUCCESS)
+        {
+            if (item->cancelled) //Cancelled between pop() and the submission
+                transport->cancel(&slot->request);
+            continue;
+        }
+        if (slot != own)
+        {
+            //Another caller's transfer, its callback runs on the event thread
+            transport->complete_later(&slot->request, err);
+            continue;
+        }
+        //The caller's own transfer fails synchronously, without a callback
+        own_err = err;
+        qos.complete(&slot->qos);
+        slot->callback = nullptr;
+        release(slot);
+        in_flight--;
+    }
+    return own_err;
+}
+
+libusb_error ChassisAsyncEngine::submit(uint8_t endpoint, uint8_t type, const void *data, int length, unsigned int timeout, CBCompletion &&callback,
+                                        CBTransferTicket *ticket)
+{
+    if (length < 0 || length > buffer_size)
+        return LIBUSB_ERROR_INVALID_PARAM;
+
+    CBEndpointPool &pool = pools[ep_index(endpoint)];
+    std::unique_lock<std::mutex> guard(pool.lock);
+    //Checked under the pool lock so stop() cannot miss a transfer while cancelling
+    if (!running)
+        return LIBUSB_ERROR_NOT_FOUND;
+    if (pool.idle.empty())
+        return LIBUSB_ERROR_BUSY;
+    CBTransferSlot *slot = pool.idle.back();
+    pool.idle.pop_back();
+
+    if (data)
+        memcpy(slot->request.buffer, data, length);
+    slot->callback = std::move(callback);
+    slot->request.type = type;
+    slot->request.length = length;
+    slot->request.timeout = timeout;
+    slot->serial++;
+    if (ticket)
+        *ticket = {endpoint, slot, slot->serial};
+
+    in_flight++;
+    if (type == LIBUSB_TRANSFER_TYPE_BULK && qos.enabled())
+    {
+        //Submitted by dispatch() once the scheduler lets it go. Failing right away is returned here,
+        //failing after other transfers completed is reported through the callback
+        slot->qos.cancelled = false;
+        qos.push(&slot->qos, qos_class(endpoint), cb_now_ns());
+        pool.busy.push_back(slot);
+        guard.unlock();
+        return dispatch(slot);
+    }
+    libusb_error err = transport->submit(&slot->request);
+    if (err < LIBUSB_SUCCESS)
+    {
+        in_flight--;
+        slot->callback = nullptr;
+        pool.idle.push_back(slot);
+        return err;
+    }
+    pool.busy.push_back(slot);
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisAsyncEngine::release(CBTransferSlot *slot)
+{
+    CBEndpointPool &pool = pools[ep_index(slot->request.endpoint)];
+    std::lock_guard<std::mutex> guard(pool.lock);
+    for (size_t i = 0; i < pool.busy.size(); i++)
+    {
+        if (pool.busy[i] == slot)
+        {
+            pool.busy[i] = pool.busy.back();
+            pool.busy.pop_back();
+            break;
+        }
+    }
+    pool.idle.push_back(slot);
+}
+
+void ChassisAsyncEngine::transfer_cb(CBTransportRequest *request, libusb_error err, int actual_length)
+{
+    CBTransferSlot *slot = static_cast<CBTransferSlot*>(request->user_data);
+    ChassisAsyncEngine *engine = slot->engine;
+
+    //Recycle the slot first so the callback is free to resubmit on the same endpoint. The completed
+    //buffer is lent to the callback and the slot continues with the spare one.
+    unsigned char *data = request->buffer;
+    unsigned char *swap = engine->spare.exchange(nullptr);
+    unsigned char copy[buffer_size];
+    if (swap)
+        request->buffer = swap;
+    else
+    {
+        //Another completion holds the spare (only if two threads handle events), fall back to a copy
+        memcpy(copy, data, actual_length);
+        data = copy;
+    }
+    CBCompletion callback = std::move(slot->callback);
+    slot->callback = nullptr;
+    engine->qos.complete(&slot->qos);
+    engine->release(slot);
+
+    if (callback)
+    {
+        bool nested = in_event_thread;
+        in_event_thread = true;
+        callback(err, data, actual_length);
+        in_event_thread = nested;
+    }
+    if (swap)
+        engine->spare = data;
+    //The freed place on the bus goes to the highest class waiting
+    engine->dispatch();
+    engine->in_flight--;
+}
+
+void ChassisAsyncEngine::event_loop()
+{
+    in_event_thread = true;
+    //Keep servicing events after stop() until every cancelled transfer has called back
+    while (running || in_flight > 0)
+    {
+        //Transfers held back by a rate budget have no completion to wake them, poll in short steps meanwhile
+        transport->handle_events(qos.has_waiting() ? 500 : 100000);
+        dispatch();
+    }
+}
+
+void ChassisAsyncEngine::free_slots()
+{
+    for (CBEndpointPool &pool : pools)
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.idle.clear();
+        pool.busy.clear();
+    }
+    for (CBTransferSlot &slot : slots)
+        if (slot.request.backend)
+            transport->release(&slot.request);
+    slots.clear();
+    spare = nullptr;
+    if (buffers.data)
+        transport->free_buffers(buffers);
+}
@@ -0,0 +1,194 @@
+#ifndef CHASSIS_ASYNC_H
+#define CHASSIS_ASYNC_H
+
+#include "chassis_qos.h"
+#include "chassis_transport.h"
+#include "dependencies/usb_dev.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @file chassis_async.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Board Asynchronous Transfer Engine
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @brief Completion callback for an asynchronous transfer.
+ *
+ * Called from the event thread once the transfer finishes.
+ *
+ * @param err `LIBUSB_SUCCESS`, or the libusb error matching the transfer status.
+ * @param data View into the completed transfer buffer, no copy is made (valid only for the duration of the callback).
+ * @param length Number of bytes actually transferred.
+ */
+using CBCompletion = std::function<void(libusb_error err, const unsigned char *data, int length)>;
+
+//Identifies one submitted transfer so it can be cancelled on its own, stale tickets are ignored
+struct CBTransferTicket
+{
+    uint8_t endpoint = 0;
+    const void *slot = nullptr;
+    uint64_t serial = 0;
+};
+
+/**
+ * @class ChassisAsyncEngine
+ * @brief Keeps several transfers in flight per endpoint and services them on one event thread.
+ *
+ * Every endpoint of the board gets a fixed pool of preallocated requests (the queue depth).
+ * Submitting takes a free transfer from the endpoint pool, so drive, servo and sensor traffic can
+ * overlap on the bus instead of running one blocking call after another.
+ *
+ * All transfer buffers come from one cache line aligned block, optionally device memory
+ * (`libusb_dev_mem_alloc()`) so the kernel moves packets without copying them. Completions hand the
+ * callback the transfer buffer itself: the request gets a spare buffer and can be resubmitted
+ * right away, and the completed buffer becomes the spare once the callback returns.
+ *
+ * With `set_qos()`, bulk transfers go through a `ChassisQosScheduler`: at most `max_in_flight` are on
+ * the bus, the rest wait in priority order (drive commands, servo commands, then reads).
+ *
+ * When the transport reports `shared_events()` (boards of a `ChassisBoardManager`), no thread is
+ * started and the manager's event thread runs the callbacks instead.
+ *
+ * @note Callbacks run on the event thread. Keep them short, never call blocking libusb functions
+ *       or `stop()` from inside them.
+ */
+class ChassisAsyncEngine
+{
+    public:
+        //Upper bound for transfers kept per endpoint
+        static constexpr int max_queue_depth = 16;
+        //Number of possible endpoint addresses (16 OUT + 16 IN)
+        static constexpr int n_endpoints = 32;
+
+        ChassisAsyncEngine() = default;
+        ChassisAsyncEngine(const ChassisAsyncEngine&) = delete;
+        ChassisAsyncEngine& operator=(const ChassisAsyncEngine&) = delete;
+        ~ChassisAsyncEngine();
+
+        /**
+         * @brief Allocates the request pools and starts the event thread.
+         *
+         * @param transport Transport with the data interfaces already claimed.
+         * @param queue_depth Transfers kept per endpoint (1 to `max_queue_depth`).
+         * @param device_memory Requests zero-copy device memory for the buffers, falls back to regular memory.
+         *
+         * @return `LIBUSB_SUCCESS`, `LIBUSB_ERROR_INVALID_PARAM` for a bad depth,
+         *         `LIBUSB_ERROR_BUSY` if already running, `LIBUSB_ERROR_NO_MEM`,
+         *         or the error of `ChassisTransport::prepare()`.
+         */
+        libusb_error start(ChassisTransport *transport, int queue_depth, bool device_memory = false);
+
+        /**
+         * @brief Cancels all in-flight transfers, waits for their callbacks and joins the event thread.
+         *
+         * Cancelled transfers complete with `LIBUSB_ERROR_INTERRUPTED`. Only the event thread delivers
+         * them, so the engine cannot be stopped from a callback.
+         *
+         * @return `LIBUSB_SUCCESS`, or `LIBUSB_ERROR_BUSY` without stopping when called on the event thread.
+         */
+        libusb_error stop();
+
+        bool is_running() const;
+
+        /**
+         * @brief Queues an OUT transfer. The payload is copied, so the caller may reuse it right away.
+         *
+         * @return `LIBUSB_SUCCESS` if submitted, `LIBUSB_ERROR_BUSY` if every transfer of the endpoint is
+         *         in flight, or the error returned by `ChassisTransport::submit()`.
+         *         The callback is only invoked when `LIBUSB_SUCCESS` is returned.
+         *         `ticket`, if given, is filled before the transfer can complete.
+         */
+        libusb_error submit_out(uint8_t endpoint, const void *data, int length, unsigned int timeout, CBCompletion callback,
+                                CBTransferTicket *ticket = nullptr);
+
+        /**
+         * @brief Queues an IN transfer of up to `length` bytes.
+         *
+         * @return Same as `submit_out()`.
+         */
+        libusb_error submit_in(uint8_t endpoint, int length, unsigned int timeout, CBCompletion callback,
+                               CBTransferTicket *ticket = nullptr);
+
+        //Queues an interrupt IN transfer (notification endpoints), otherwise same as `submit_in()`
+        libusb_error submit_interrupt_in(uint8_t endpoint, int length, unsigned int timeout, CBCompletion callback);
+
+        //Cancels every transfer in flight on `endpoint`, their callbacks report `LIBUSB_ERROR_INTERRUPTED`
+        void cancel(uint8_t endpoint);
+        //Cancels one transfer, does nothing if it already completed
+        void cancel(const CBTransferTicket &ticket);
+
+        //Returns the number of transfers currently in flight across all endpoints
+        int get_in_flight() const;
+
+        //Whether the running engine got device memory for its buffers
+        bool uses_device_memory() const;
+
+        //Sets the bus scheduler bulk transfers go through, `max_in_flight = 0` sends them right away (the default)
+        void set_qos(const CBQosConfig &config);
+        CBQosConfig get_qos();
+        bool qos_enabled() const;
+        CBQosStats get_qos_stats();
+
+        //Whether the calling thread is the event thread or runs a completion callback, blocking on a
+        //transfer there would wait for itself
+        static bool on_event_thread();
+
+        //Largest payload of one transfer
+        static constexpr int buffer_size = DRVM_DATA_SZ;
+
+    private:
+        struct CBTransferSlot
+        {
+            ChassisAsyncEngine *engine = nullptr;
+            CBTransportRequest request;
+            CBCompletion callback;
+            uint64_t serial = 0; //Bumped on every submission, matched against tickets
+            ChassisQosScheduler::CBQosItem qos;
+        };
+        struct CBEndpointPool
+        {
+            std::mutex lock;
+            std::vector<CBTransferSlot*> idle;
+            std::vector<CBTransferSlot*> busy;
+        };
+
+        //Buffers are spaced a cache line apart so neighbouring transfers never share one
+        static constexpr size_t buffer_stride = (buffer_size + 63) & ~(size_t)63;
+
+        ChassisTransport *transport = nullptr;
+        std::vector<CBTransferSlot> slots;
+        CBBufferBlock buffers;
+        //Buffer swapped into a request while its completed buffer is lent to the callback
+        std::atomic<unsigned char*> spare{nullptr};
+        CBEndpointPool pools[n_endpoints];
+        std::atomic<bool> running{false};
+        std::atomic<int> in_flight{0};
+        std::thread event_thread;
+        ChassisQosScheduler qos;
+
+        static int ep_index(uint8_t endpoint);
+        static eCBQosClass qos_class(uint8_t endpoint);
+        static void transfer_cb(CBTransportRequest *request, libusb_error err, int actual_length);
+        libusb_error submit(uint8_t endpoint, uint8_t type, const void *data, int length, unsigned int timeout, CBCompletion &&callback,
+                            CBTransferTicket *ticket = nullptr);
+        void release(CBTransferSlot *slot);
+        //Cancels a slot of `pools`, queued or on the bus (pool lock held)
+        void cancel_slot(CBTransferSlot *slot);
+        //Submits the transfers the scheduler lets go (no pool lock held). Transfers that fail or were
+        //cancelled while queued complete on the event thread, except `own`, whose error is returned
+        libusb_error dispatch(CBTransferSlot *own = nullptr);
+        void event_loop();
+        void free_slots();
+};
+
+#endif
@@ -1,94 +1,457 @@
 #include "chassis_board.h"
+#include "chassis_clock.h"
+#include "chassis_transport_libusb.h"
+#include <cerrno>
+#include <cstring>
+#include <memory>
 
 ChassisBoard::ChassisBoard() : sensors(*this), servos(*this), DrvMtr(*this)
 {
-    device_desc = new libusb_device_descriptor;
+    owned_transport.reset(new ChassisLibusbTransport());
+    transport = owned_transport.get();
+    transport->set_link_handler([this](bool connected) { on_link_change(connected); });
+}
+
+ChassisBoard::ChassisBoard(const std::string &bus_path) : sensors(*this), servos(*this), DrvMtr(*this)
+{
+    owned_transport.reset(new ChassisLibusbTransport(bus_path));
+    transport = owned_transport.get();
+    transport->set_link_handler([this](bool connected) { on_link_change(connected); });
+}
+
+ChassisBoard::ChassisBoard(ChassisTransport &transport) : transport(&transport), sensors(*this), servos(*this), DrvMtr(*this)
+{
+    this->transport->set_link_handler([this](bool connected) { on_link_change(connected); });
 }
 
 libusb_error ChassisBoard::initialize(libusb_log_level log_lvl)
 {
+    return transport->open(log_lvl);
+}
+
+libusb_error ChassisBoard::claimInterfaces()
+{
+    return transport->claim_interfaces();
+}
+
+libusb_error ChassisBoard::start_async(int queue_depth, bool device_memory)
+{
+    return async_engine.start(transport, queue_depth, device_memory);
+}
+
+libusb_error ChassisBoard::stop_async()
+{
+    return async_engine.stop();
+}
+
+libusb_error ChassisBoard::set_qos(const CBQosConfig &config)
+{
+    if (config.max_in_flight < 0)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    for (int c = 0; c < eN_QosClass; c++)
+        if (config.rate_budget[c] < 0)
+            return LIBUSB_ERROR_INVALID_PARAM;
+    async_engine.set_qos(config);
+    return LIBUSB_SUCCESS;
+}
+
+CBQosConfig ChassisBoard::get_qos()
+{
+    return async_engine.get_qos();
+}
+
+CBQosStats ChassisBoard::get_qos_stats()
+{
+    return async_engine.get_qos_stats();
+}
+
+libusb_error ChassisBoard::start_status_listener()
+{
+    if (!async_engine.is_running())
+        return LIBUSB_ERROR_NOT_FOUND;
+    if (status_listening.exchange(true))
+        return LIBUSB_ERROR_BUSY;
+
     int err = 0;
-    //Initialize LIBUSB context
-    err = libusb_init(&ctx);
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-
-    //Set debug log level
-    err = libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, log_lvl);
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-
-    //Discover Devices
-    ssize_t count = libusb_get_device_list(ctx, &list_of_devices);
-    if (count < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-        
-    //Find required device
-    for (ssize_t i = 0; i < count; i++)
+    if (!ntf_claimed)
     {
-        libusb_get_device_descriptor(list_of_devices[i], device_desc);
-        if (B_PID == device_desc->idProduct && B_VID == device_desc->idVendor)
+        err = transport->claim_interface(DRVM_NTF_INUM);
+        if (err == LIBUSB_SUCCESS)
+            err = transport->claim_interface(SRVO_NTF_INUM);
+        if (err < LIBUSB_SUCCESS)
         {
-            device = list_of_devices[i];
-            break;
+            status_listening = false;
+            return (libusb_error)err;
         }
+        ntf_claimed = true;
     }
 
-    //Verify if the board was found
-    if (device == nullptr) 
-        return (libusb_error)err;
-    
-    return LIBUSB_SUCCESS;
+    err = arm_status_read(DRVM_NTF_EP);
+    if (err == LIBUSB_SUCCESS)
+        err = arm_status_read(SRVO_NTF_EP);
+    if (err < LIBUSB_SUCCESS)
+        stop_status_listener();
+    return (libusb_error)err;
 }
 
-libusb_error ChassisBoard::claimInterfaces()
+void ChassisBoard::stop_status_listener()
 {
-    int err = 0;
-    //Handle Device
-    err = libusb_open(device, &handle);
-    libusb_free_device_list(list_of_devices, 1);
-    list_of_devices = nullptr;
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-
-    //Detaches kernel driver if applicable
-    #ifndef CHASSIS_KDBYPASS_DRVMTR
-    if (libusb_kernel_driver_active(handle, DRVM_DATA_INUM))
+    status_listening = false;
+    async_engine.cancel(DRVM_NTF_EP);
+    async_engine.cancel(SRVO_NTF_EP);
+}
+
+int ChassisBoard::add_status_handler(CBStatusHandler handler)
+{
+    std::lock_guard<std::mutex> guard(status_lock);
+    status_handlers.emplace_back(next_handler_id, std::move(handler));
+    return next_handler_id++;
+}
+
+void ChassisBoard::remove_status_handler(int handler_id)
+{
+    std::lock_guard<std::mutex> guard(status_lock);
+    for (size_t i = 0; i < status_handlers.size(); i++)
     {
-        err = libusb_detach_kernel_driver(handle, DRVM_DATA_INUM);
-        if (err < LIBUSB_SUCCESS) 
-            return (libusb_error)err;
+        if (status_handlers[i].first == handler_id)
+        {
+            status_handlers.erase(status_handlers.begin() + i);
+            return;
+        }
     }
-    #endif
-    #ifndef CHASSIS_KDBYPASS_SERVO
-    if (libusb_kernel_driver_active(handle, SRVO_DATA_INUM))
+}
+
+libusb_error ChassisBoard::arm_status_read(uint8_t endpoint)
+{
+    //No timeout, the read completes when the board notifies or when it gets cancelled
+    uint64_t start_ns = cb_now_ns();
+    return async_engine.submit_interrupt_in(endpoint, DRVM_NTF_SZ, 0,
+        [this, endpoint, start_ns](libusb_error cb_err, const unsigned char *data, int length) {
+            //Recorded for replay, except the cancellations of stop_status_listener()
+            ChassisRecorder *rec = recorder.load(std::memory_order_acquire);
+            if (rec && cb_err != LIBUSB_ERROR_INTERRUPTED)
+            {
+                uint64_t now = cb_now_ns();
+                rec->record(endpoint, cb_err, data, length, now, now - start_ns);
+            }
+            if (cb_err == LIBUSB_SUCCESS && length >= (int)sizeof(udev_status))
+            {
+                udev_status status;
+                memcpy(&status, data, sizeof(status));
+                dispatch_status(endpoint, status);
+            }
+            if (status_listening && cb_err != LIBUSB_ERROR_INTERRUPTED && cb_err != LIBUSB_ERROR_NO_DEVICE)
+                arm_status_read(endpoint);
+        });
+}
+
+void ChassisBoard::on_link_change(bool connected)
+{
+    if (!connected)
+        return;
+    //The reads armed before the outage all failed with LIBUSB_ERROR_NO_DEVICE, arm them again
+    sensors.resume_stream();
+    if (status_listening)
     {
-        err = libusb_detach_kernel_driver(handle, SRVO_DATA_INUM);
-        if (err < LIBUSB_SUCCESS) 
-            return (libusb_error)err;
+        arm_status_read(DRVM_NTF_EP);
+        arm_status_read(SRVO_NTF_EP);
     }
-    #endif
-    #ifndef CHASSIS_KDBYPASS_SENSOR
-    if (libusb_kernel_driver_active(handle, SENS_DATA_INUM))
+}
+
+int ChassisBoard::start_command_pump(double rate_hz)
+{
+    if (command_pump && command_pump->is_running())
+        return EBUSY;
+    command_pump.reset(new ChassisLoopScheduler(rate_hz));
+    return command_pump->start([this](uint64_t) {
+        for (int i = 0; i < eN_DrvMotor; i++)
+            pump_channel(DrvMtr.channels[i], DrvMtr.counters, CBDriveMotorEndpoint::out_ep);
+        for (int i = 0; i < eN_Servo; i++)
+            pump_channel(servos.channels[i], servos.counters, CBServoEndpoint::out_ep);
+    });
+}
+
+void ChassisBoard::stop_command_pump()
+{
+    if (command_pump)
+        command_pump->stop();
+}
+
+void ChassisBoard::play_trajectories()
+{
+    uint64_t now = cb_now_ns();
+    for (int servo = 0; servo < eN_Servo; servo++)
     {
-        err = libusb_detach_kernel_driver(handle, SENS_DATA_INUM);
-        if (err < LIBUSB_SUCCESS) 
-            return (libusb_error)err;
+        std::unique_lock<std::mutex> guard(servos.track_lock);
+        CBTrajectoryTrack &track = servos.tracks[servo];
+        if (!track.trajectory || track.in_flight)
+            continue;
+        std::shared_ptr<const ChassisServoTrajectory> trajectory = track.trajectory;
+        const std::vector<uint32_t> &setpoints = trajectory->get_setpoints();
+        size_t index = (size_t)((now - track.start_ns) * trajectory->get_rate() / 1e9);
+        bool last = index >= setpoints.size() - 1;
+        if (last)
+            index = setpoints.size() - 1;
+        if (index == track.last_sent)
+        {
+            if (last)
+                track.trajectory.reset();
+            continue;
+        }
+        track.in_flight = true;
+        guard.unlock();
+
+        udev_pkt_srvo_ctrl packet;
+        packet.srvo_id = servo;
+        packet.srvo_ctrl = setpoints[index];
+        uint8_t endpoint = CBServoEndpoint::out_ep;
+        uint64_t start_ns = cb_now_ns();
+        //Marks the setpoint sent unless the track was replaced meanwhile, a failed one is sent again next tick
+        auto finish = [this, servo, trajectory, index](libusb_error err) {
+            std::lock_guard<std::mutex> done_guard(servos.track_lock);
+            CBTrajectoryTrack &done = servos.tracks[servo];
+            if (done.trajectory == trajectory && err == LIBUSB_SUCCESS)
+                done.last_sent = index;
+            done.in_flight = false;
+        };
+        int err = async_engine.submit_out(endpoint, &packet, sizeof(packet), timeout,
+            [this, endpoint, start_ns, finish](libusb_error cb_err, const unsigned char *data, int length) {
+                account(servos.counters, endpoint, cb_err, data, length, start_ns);
+                finish(cb_err);
+            });
+        if (err == LIBUSB_ERROR_NOT_FOUND) //No async engine
+        {
+            int length = 0;
+            err = transport->transfer(endpoint, (unsigned char *)&packet, sizeof(packet), &length, timeout);
+            account(servos.counters, endpoint, err, &packet, length, start_ns);
+            finish((libusb_error)err);
+        }
+        else if (err != LIBUSB_SUCCESS)
+            finish((libusb_error)err);
     }
-    #endif 
-
-    //Claim the Interfaces
-    err = libusb_claim_interface(handle, DRVM_DATA_INUM);
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-    err = libusb_claim_interface(handle, SRVO_DATA_INUM);
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
-    err = libusb_claim_interface(handle, SENS_DATA_INUM);
-    if (err < LIBUSB_SUCCESS) 
-        return (libusb_error)err;
+}
 
-    return LIBUSB_SUCCESS;
+int ChassisBoard::start_watchdog(const CBWatchdogConfig &config, CBWatchdogHandler handler)
+{
+    if (watchdog.is_running())
+        return EBUSY;
+    for (int i = 0; i < eN_DrvMotor; i++)
+    {
+        failsafe_packets[i] = {};
+        failsafe_packets[i].mtr_id = i;
+        failsafe_packets[i].mtr_ctrl.enable = 0;
+    }
+    unsigned int timeout_ms = config.failsafe_timeout_ms;
+    return watchdog.start(config, [this, timeout_ms]() { return send_failsafe(timeout_ms); }, std::move(handler));
+}
+
+bool ChassisBoard::write_blocked(uint8_t endpoint)
+{
+    if (endpoint != DRVM_RXD_EP || !watchdog.is_tripped())
+        return false;
+    watchdog.note_blocked_write(cb_now_ns());
+    return true;
+}
+
+void ChassisBoard::stop_watchdog()
+{
+    watchdog.stop();
+}
+
+void ChassisBoard::feed_watchdog()
+{
+    watchdog.note_write(cb_now_ns());
+}
+
+CBWatchdogStats ChassisBoard::get_watchdog_stats()
+{
+    return watchdog.get_stats();
+}
+
+libusb_error ChassisBoard::send_failsafe(unsigned int timeout_ms)
+{
+    //Drive commands still queued would re-enable the motors after the failsafe
+    if (async_engine.is_running())
+        async_engine.cancel(DRVM_RXD_EP);
+    //The motors no longer run the last pumped commands, the pump sends them again once the trip clears
+    for (int i = 0; i < eN_DrvMotor; i++)
+        DrvMtr.channels[i].failed = true;
+    //Every motor is tried even if one fails, the first error is reported and the watchdog retries
+    int first_err = LIBUSB_SUCCESS;
+    for (udev_pkt_drvm_ctrl &packet : failsafe_packets)
+    {
+        int length = 0;
+        uint64_t start_ns = cb_now_ns();
+        int err = transport->transfer(DRVM_RXD_EP, (unsigned char *)&packet, sizeof(packet), &length, timeout_ms);
+        account(DrvMtr.counters, DRVM_RXD_EP, err, &packet, length, start_ns);
+        if (err != LIBUSB_SUCCESS && first_err == LIBUSB_SUCCESS)
+            first_err = err;
+    }
+    return (libusb_error)first_err;
+}
+
+CBPumpStats ChassisBoard::get_pump_stats()
+{
+    uint64_t posted = 0;
+    for (auto &channel : DrvMtr.channels)
+        posted += channel.mailbox.get_posted();
+    for (auto &channel : servos.channels)
+        posted += channel.mailbox.get_posted();
+    return {posted, pump_sent.load(), pump_coalesced.load(), pump_unchanged.load()};
+}
+
+template <typename Packet>
+void ChassisBoard::pump_channel(CBPumpChannel<Packet> &channel, CBInterfaceCounters &counters, uint8_t endpoint)
+{
+    uint64_t skipped = 0;
+    if (channel.mailbox.take(channel.wanted, &skipped))
+    {
+        channel.has_wanted = true;
+        channel.fresh = true;
+        pump_coalesced.fetch_add(skipped, std::memory_order_relaxed);
+    }
+    //A failed write leaves the board state unknown, so the command is sent again
+    if (channel.failed.exchange(false))
+        channel.sent_valid = false;
+    //One command per channel in flight, newer ones wait in the mailbox instead of the queue
+    if (!channel.has_wanted || channel.in_flight)
+        return;
+    if (channel.sent_valid && memcmp(&channel.wanted, &channel.sent, sizeof(Packet)) == 0)
+    {
+        if (channel.fresh)
+            pump_unchanged.fetch_add(1, std::memory_order_relaxed);
+        channel.fresh = false;
+        return;
+    }
+    channel.fresh = false;
+
+    Packet packet = channel.wanted;
+    uint64_t start_ns = cb_now_ns();
+    int err;
+    if (write_blocked(endpoint))
+        err = LIBUSB_ERROR_ACCESS;
+    else if (async_engine.is_running())
+    {
+        channel.in_flight = true;
+        err = async_engine.submit_out(endpoint, &packet, sizeof(packet), timeout,
+            [this, &channel, &counters, endpoint, start_ns](libusb_error cb_err, const unsigned char *data, int length) {
+                account(counters, endpoint, cb_err, data, length, start_ns);
+                if (cb_err != LIBUSB_SUCCESS)
+                    channel.failed = true;
+                channel.in_flight = false;
+            });
+        if (err != LIBUSB_SUCCESS)
+            channel.in_flight = false;
+    }
+    else
+    {
+        int length = 0;
+        err = transport->transfer(endpoint, (unsigned char *)&packet, sizeof(packet), &length, timeout);
+        account(counters, endpoint, err, &packet, length, start_ns);
+    }
+    //Not sent, tried again next cycle
+    if (err != LIBUSB_SUCCESS)
+        return;
+    channel.sent = packet;
+    channel.sent_valid = true;
+    pump_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChassisBoard::on_status_packet(const udev_pkt_drvm_sts &packet)
+{
+    uint64_t now = cb_now_ns();
+    watchdog.note_status(packet.status.code, now);
+    CBPacketListener *listener = packet_listener.load(std::memory_order_acquire);
+    if (listener)
+        listener->on_packet(packet, now);
+}
+
+void ChassisBoard::on_status_packet(const udev_pkt_sens_sts &packet)
+{
+    uint64_t now = cb_now_ns();
+    sensors.filter.push(packet, now);
+    CBPacketListener *listener = packet_listener.load(std::memory_order_acquire);
+    if (listener)
+        listener->on_packet(packet, now);
+}
+
+void ChassisBoard::set_packet_listener(CBPacketListener *listener)
+{
+    packet_listener.store(listener, std::memory_order_release);
+}
+
+CBLinkStats ChassisBoard::get_link_stats()
+{
+    return transport->get_link_stats();
+}
+
+CBStartupStats ChassisBoard::get_startup_stats()
+{
+    return transport->get_startup_stats();
+}
+
+void ChassisBoard::dispatch_status(uint8_t endpoint, const udev_status &status)
+{
+    if (endpoint == DRVM_NTF_EP)
+        watchdog.note_status(status.code, cb_now_ns());
+    udev_status &last = endpoint == DRVM_NTF_EP ? last_drvm_status : last_srvo_status;
+    if (last.code == status.code && last.value == status.value)
+        return;
+    last = status;
+
+    //Copied so handlers may add or remove handlers themselves
+    std::vector<std::pair<int, CBStatusHandler>> handlers;
+    {
+        std::lock_guard<std::mutex> guard(status_lock);
+        handlers = status_handlers;
+    }
+    for (auto &handler : handlers)
+        handler.second(endpoint, status);
+}
+
+CBInterfaceStats ChassisBoard::CBInterfaceCounters::snapshot() const
+{
+    return {bytes_sent.load(), bytes_recv.load(), transfers.load(), errors.load()};
+}
+
+void ChassisBoard::account(CBInterfaceCounters &counters, uint8_t endpoint, int err, const void *data, int length, uint64_t start_ns)
+{
+    bool is_in = endpoint & LIBUSB_ENDPOINT_IN;
+    (is_in ? bytes_recv : bytes_sent).store(length, std::memory_order_relaxed);
+    (is_in ? counters.bytes_recv : counters.bytes_sent).fetch_add(length, std::memory_order_relaxed);
+    counters.transfers.fetch_add(1, std::memory_order_relaxed);
+    if (err != LIBUSB_SUCCESS)
+        counters.errors.fetch_add(1, std::memory_order_relaxed);
+    uint64_t now = cb_now_ns();
+    metrics.record(endpoint, err, length, now - start_ns);
+    if (err == LIBUSB_SUCCESS && endpoint == DRVM_RXD_EP)
+        watchdog.note_write(now);
+    else if (err == LIBUSB_SUCCESS && endpoint == DRVM_TXD_EP)
+        watchdog.note_read(now);
+
+    ChassisRecorder *rec = recorder.load(std::memory_order_acquire);
+    if (rec)
+        rec->record(endpoint, err, data, length, now, now - start_ns);
+}
+
+std::vector<CBEndpointMetrics> ChassisBoard::get_metrics()
+{
+    return metrics.snapshot();
+}
+
+int ChassisBoard::start_metrics_export(const char *path, unsigned interval_ms, const std::string &labels)
+{
+    return metrics.start_export(path, interval_ms, labels);
+}
+
+void ChassisBoard::stop_metrics_export()
+{
+    metrics.stop_export();
+}
+
+void ChassisBoard::attach_recorder(ChassisRecorder *rec)
+{
+    recorder.store(rec, std::memory_order_release);
 }
 
 int ChassisBoard::get_bytes_recv()
@@ -103,16 +466,20 @@ int ChassisBoard::get_bytes_sent()
 
 ChassisBoard::~ChassisBoard()
 {
-    if (device_desc) { //This was allocated in the constructor
-        delete device_desc;
-        device_desc = nullptr;
+    transport->set_link_handler(nullptr);
+    stop_watchdog();
+    stop_command_pump();
+    {
+        std::lock_guard<std::mutex> guard(player_lock);
+        if (trajectory_player)
+            trajectory_player->stop();
+    }
+    stop_async(); //Pending transfers must finish before the transport goes away
+    if (ntf_claimed)
+    {
+        transport->release_interface(DRVM_NTF_INUM);
+        transport->release_interface(SRVO_NTF_INUM);
     }
-    libusb_release_interface(handle, DRVM_DATA_INUM);
-    libusb_release_interface(handle, SRVO_DATA_INUM);
-    libusb_release_interface(handle, SENS_DATA_INUM);
-    libusb_free_device_list(list_of_devices, 1);
-    libusb_close(handle);
-    libusb_exit(ctx);
 }
 
 // libusb_error ChassisBoard::CBSensorInterface::write()
@@ -121,174 +488,384 @@ ChassisBoard::~ChassisBoard()
 //     return (libusb_error)err;
 // }
 
-libusb_error ChassisBoard::CBSensorInterface::read()
+libusb_error ChassisBoard::CBSensorInterface::start_stream(int depth)
 {
-    err = libusb_bulk_transfer(chassis.handle, SENS_TXD_EP, (unsigned char*)&packet_SENSO, sizeof(packet_SENSO), &chassis.bytes_recv, timeout);
-    return (libusb_error)err;
+    if (streaming.exchange(true))
+        return LIBUSB_ERROR_BUSY;
+    stream_depth = depth;
+    libusb_error first_err = LIBUSB_SUCCESS;
+    //Reads of a previous stream still in flight re-arm themselves and count towards `depth`
+    for (int i = stream_armed; i < depth; i++)
+    {
+        libusb_error arm_err = arm_stream_read();
+        if (arm_err != LIBUSB_SUCCESS && first_err == LIBUSB_SUCCESS)
+            first_err = arm_err;
+    }
+    if (stream_armed == 0)
+    {
+        streaming = false;
+        return first_err == LIBUSB_SUCCESS ? LIBUSB_ERROR_INVALID_PARAM : first_err;
+    }
+    return LIBUSB_SUCCESS;
 }
 
-libusb_error ChassisBoard::CBServoInterface::write()
+void ChassisBoard::CBSensorInterface::stop_stream()
 {
-    err = libusb_bulk_transfer(chassis.handle, SRVO_RXD_EP, (unsigned char *)&packet_SI, sizeof(packet_SI), &chassis.bytes_sent, timeout);
-    return (libusb_error)err;
+    streaming = false;
 }
 
-libusb_error ChassisBoard::CBServoInterface::read()
+bool ChassisBoard::CBSensorInterface::is_streaming()
 {
-    err = libusb_bulk_transfer(chassis.handle, SRVO_TXD_EP, (unsigned char*)&packet_SO, sizeof(packet_SO), &chassis.bytes_recv, timeout);
-    return (libusb_error)err;
+    return streaming && stream_armed > 0;
 }
 
-libusb_error ChassisBoard::CBDriveMotorInterface::write()
+size_t ChassisBoard::CBSensorInterface::drain(CBSensorSample *out, size_t max)
 {
-    err = libusb_bulk_transfer(chassis.handle, DRVM_RXD_EP, (unsigned char *)&packet_MI, sizeof(packet_MI), &chassis.bytes_sent, timeout);    
-    return (libusb_error)err;
+    return stream_ring.pop_batch(out, max);
 }
 
-libusb_error ChassisBoard::CBDriveMotorInterface::read()
+uint64_t ChassisBoard::CBSensorInterface::get_dropped()
 {
-    err = libusb_bulk_transfer(chassis.handle, DRVM_TXD_EP, (unsigned char*)&packet_MO, sizeof(packet_MO), &chassis.bytes_recv, timeout);
-    return (libusb_error)err;
+    return stream_dropped;
+}
+
+void ChassisBoard::CBSensorInterface::resume_stream()
+{
+    if (!streaming)
+        return;
+    for (int i = stream_armed; i < stream_depth; i++)
+        arm_stream_read();
+}
+
+libusb_error ChassisBoard::CBSensorInterface::set_filter(const CBAdcFilterConfig &config)
+{
+    return filter.configure(config) ? LIBUSB_SUCCESS : LIBUSB_ERROR_INVALID_PARAM;
+}
+
+CBAdcFilterConfig ChassisBoard::CBSensorInterface::get_filter()
+{
+    return filter.get_config();
+}
+
+bool ChassisBoard::CBSensorInterface::get_filtered(CBAdcFilterSample &sample)
+{
+    return filter.get_latest(sample);
+}
+
+libusb_error ChassisBoard::CBSensorInterface::arm_stream_read()
+{
+    stream_armed++;
+    uint64_t start_ns = cb_now_ns();
+    libusb_error arm_err = chassis.async_engine.submit_in(CBSensorEndpoint::in_ep, sizeof(packet_sts), timeout,
+        [this, start_ns](libusb_error cb_err, const unsigned char *data, int length) {
+            chassis.account(counters, CBSensorEndpoint::in_ep, cb_err, data, length, start_ns);
+            if (cb_err == LIBUSB_SUCCESS && length == sizeof(udev_pkt_sens_sts))
+            {
+                CBSensorSample sample;
+                sample.timestamp_ns = cb_now_ns();
+                const udev_pkt_sens_sts *packet = reinterpret_cast<const udev_pkt_sens_sts*>(data);
+                memcpy(sample.adc_vals, packet->adc_vals, sizeof(sample.adc_vals));
+                memcpy(sample.adc_volts, packet->adc_volts, sizeof(sample.adc_volts));
+                chassis.on_status_packet(*packet);
+                if (!filter.get_latest(sample.filtered))
+                    sample.filtered = CBAdcFilterSample{};
+                if (!stream_ring.push(sample))
+                    stream_dropped++;
+            }
+            int armed = --stream_armed;
+            //Timeouts just mean the board had nothing to say, anything else ends the stream. Never more
+            //than `stream_depth` reads, a restart may have armed new ones while this one was in flight.
+            if (streaming && armed < stream_depth && (cb_err == LIBUSB_SUCCESS || cb_err == LIBUSB_ERROR_TIMEOUT))
+                arm_stream_read();
+        });
+    if (arm_err != LIBUSB_SUCCESS)
+        stream_armed--;
+    return arm_err;
+}
+
+libusb_error ChassisBoard::CBServoInterface::post(const udev_pkt_srvo_ctrl &packet)
+{
+    if (packet.srvo_id >= eN_Servo)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    channels[packet.srvo_id].mailbox.post(packet);
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisBoard::CBServoInterface::post()
+{
+    std::unique_lock<std::mutex> guard(packet_lock);
+    udev_pkt_srvo_ctrl packet = packet_ctrl;
+    guard.unlock();
+    return post(packet);
+}
+
+libusb_error ChassisBoard::CBServoInterface::play(const ChassisServoTrajectory &trajectory)
+{
+    eChassisServo servo = trajectory.get_servo();
+    if (servo < 0 || servo >= eN_Servo || trajectory.get_setpoints().empty())
+        return LIBUSB_ERROR_INVALID_PARAM;
+    auto shared = std::make_shared<const ChassisServoTrajectory>(trajectory);
+    int64_t period_ns = (int64_t)(1e9 / trajectory.get_rate());
+
+    std::lock_guard<std::mutex> player_guard(chassis.player_lock);
+    std::unique_ptr<ChassisLoopScheduler> &player = chassis.trajectory_player;
+    if (player && player->is_running() && player->get_period_ns() != period_ns)
+    {
+        for (int i = 0; i < eN_Servo; i++)
+            if (i != servo && is_playing((eChassisServo)i))
+                return LIBUSB_ERROR_INVALID_PARAM;
+        player->stop();
+    }
+    {
+        std::lock_guard<std::mutex> guard(track_lock);
+        CBTrajectoryTrack &track = tracks[servo];
+        track.trajectory = shared;
+        track.start_ns = cb_now_ns();
+        track.last_sent = SIZE_MAX;
+    }
+    if (!player || !player->is_running())
+    {
+        player.reset(new ChassisLoopScheduler(trajectory.get_rate()));
+        if (player->start([this](uint64_t) { chassis.play_trajectories(); }) != 0)
+        {
+            stop_trajectory(servo);
+            return LIBUSB_ERROR_OTHER;
+        }
+    }
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisBoard::CBServoInterface::stop_trajectory(eChassisServo servo)
+{
+    if (servo < 0 || servo >= eN_Servo)
+        return;
+    std::lock_guard<std::mutex> guard(track_lock);
+    tracks[servo].trajectory.reset();
+}
+
+bool ChassisBoard::CBServoInterface::is_playing(eChassisServo servo)
+{
+    if (servo < 0 || servo >= eN_Servo)
+        return false;
+    std::lock_guard<std::mutex> guard(track_lock);
+    return tracks[servo].trajectory != nullptr;
+}
+
+libusb_error ChassisBoard::CBDriveMotorInterface::write_batch(const udev_mtr_ctrl (&setpoints)[eN_DrvMotor], CBDriveBatchResult callback)
+{
+    struct BatchState
+    {
+        std::atomic<int> remaining{eN_DrvMotor};
+        CBDriveBatchResults results;
+        CBDriveBatchResult callback;
+        void complete(int motor, libusb_error motor_err)
+        {
+            results[motor] = motor_err;
+            if (--remaining == 0 && callback)
+                callback(results);
+        }
+    };
+    auto state = std::make_shared<BatchState>();
+    state->callback = std::move(callback);
+
+    //Refused motors still complete, so the callback always runs
+    bool blocked = chassis.write_blocked(CBDriveMotorEndpoint::out_ep);
+    std::unique_lock<std::mutex> guard(packet_lock);
+    udev_pkt_drvm_ctrl packet = packet_ctrl;
+    guard.unlock();
+    libusb_error first_err = LIBUSB_SUCCESS;
+    for (int motor = 0; motor < eN_DrvMotor; motor++)
+    {
+        packet.mtr_id = motor;
+        packet.mtr_ctrl = setpoints[motor];
+        uint64_t start_ns = cb_now_ns();
+        libusb_error submit_err = blocked ? LIBUSB_ERROR_ACCESS
+            : chassis.async_engine.submit_out(CBDriveMotorEndpoint::out_ep, &packet, sizeof(packet), timeout,
+            [this, start_ns, state, motor](libusb_error cb_err, const unsigned char *data, int length) {
+                chassis.account(counters, CBDriveMotorEndpoint::out_ep, cb_err, data, length, start_ns);
+                state->complete(motor, cb_err);
+            });
+        if (submit_err != LIBUSB_SUCCESS)
+        {
+            if (first_err == LIBUSB_SUCCESS)
+                first_err = submit_err;
+            state->complete(motor, submit_err);
+        }
+    }
+    return first_err;
+}
+
+libusb_error ChassisBoard::CBDriveMotorInterface::write_batch(const udev_mtr_ctrl (&setpoints)[eN_DrvMotor], CBDriveBatchResults &results)
+{
+    std::promise<CBDriveBatchResults> done;
+    std::future<CBDriveBatchResults> result = done.get_future();
+    write_batch(setpoints, [&done](const CBDriveBatchResults &batch) { done.set_value(batch); });
+    results = result.get();
+    for (libusb_error motor_err : results)
+        if (motor_err != LIBUSB_SUCCESS)
+            return motor_err;
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisBoard::CBDriveMotorInterface::post(const udev_pkt_drvm_ctrl &packet)
+{
+    if (packet.mtr_id >= eN_DrvMotor)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    channels[packet.mtr_id].mailbox.post(packet);
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisBoard::CBDriveMotorInterface::post()
+{
+    std::unique_lock<std::mutex> guard(packet_lock);
+    udev_pkt_drvm_ctrl packet = packet_ctrl;
+    guard.unlock();
+    return post(packet);
 }
 
 #ifndef CHASSIS_RMV_EZ_MODE
 
 uint32_t ChassisBoard::CBSensorInterface::get_ADCVals(eChassisADC sensorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (sensorID == eN_DrvADC)
         return 0;
-    return packet_SENSO.adc_vals[sensorID];
+    return packet_sts.adc_vals[sensorID];
 }
 
 float ChassisBoard::CBSensorInterface::get_ADCVolts(eChassisADC sensorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (sensorID == eN_DrvADC)
         return 0;
-    return packet_SENSO.adc_volts[sensorID];    
+    return packet_sts.adc_volts[sensorID];    
+}
+
+float ChassisBoard::CBSensorInterface::get_ADCFilteredVals(eChassisADC sensorID)
+{
+    CBAdcFilterSample sample;
+    if (sensorID == eN_DrvADC || !filter.get_latest(sample))
+        return 0;
+    return sample.adc_vals[sensorID];
+}
+
+float ChassisBoard::CBSensorInterface::get_ADCFilteredVolts(eChassisADC sensorID)
+{
+    CBAdcFilterSample sample;
+    if (sensorID == eN_DrvADC || !filter.get_latest(sample))
+        return 0;
+    return sample.adc_volts[sensorID];
 }
 
 void ChassisBoard::CBServoInterface::set_ID(eChassisServo servoID)
 {
-    packet_SI.srvo_id = servoID;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.srvo_id = servoID;
 }
 
 void ChassisBoard::CBServoInterface::set_CTRL(uint32_t servoCTRL)
 {
-    packet_SI.srvo_ctrl = servoCTRL;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.srvo_ctrl = servoCTRL;
 }
 
 uint8_t ChassisBoard::CBServoInterface::get_Len()
 {
-    return packet_SO.len;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    return packet_sts.len;
 }
 
 const uint8_t* ChassisBoard::CBServoInterface::get_Buf()
 {
-    return packet_SO.buf;
+    return packet_sts.buf;
 }
 
 float ChassisBoard::CBServoInterface::get_Temp()
 {
-    return packet_SO.core_temp;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    return packet_sts.core_temp;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_ID(eDrvMotors mtrID)
 {
-    packet_MI.mtr_id = mtrID;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.mtr_id = mtrID;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_LightCTRL(uint8_t bitPat)
 {
-    packet_MI.light_ctrl = bitPat;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.light_ctrl = bitPat;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_Pos(float position)
 {
-    packet_MI.mtr_ctrl.position = position;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.mtr_ctrl.position = position;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_Vel(float velocity)
 {
-    packet_MI.mtr_ctrl.velocity = velocity;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.mtr_ctrl.velocity = velocity;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_PIDctrl(float kP, float kI, float kD, float kF)
 {
-    packet_MI.mtr_ctrl.kP = kP;
-    packet_MI.mtr_ctrl.kI = kI;
-    packet_MI.mtr_ctrl.kD = kD;
-    packet_MI.mtr_ctrl.kF = kF;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.mtr_ctrl.kP = kP;
+    packet_ctrl.mtr_ctrl.kI = kI;
+    packet_ctrl.mtr_ctrl.kD = kD;
+    packet_ctrl.mtr_ctrl.kF = kF;
 }
 
 void ChassisBoard::CBDriveMotorInterface::set_ActiveStatus(bool toggle)
 {
-    packet_MI.mtr_ctrl.enable = toggle ? 0x1 : 0x0; 
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl.mtr_ctrl.enable = toggle ? 0x1 : 0x0; 
 }
 
 uint8_t ChassisBoard::CBDriveMotorInterface::get_Status_Code()
 {
-    return packet_MO.status.code;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    return packet_sts.status.code;
 }
 
 uint8_t ChassisBoard::CBDriveMotorInterface::get_Status_Val()
 {
-    return packet_MO.status.value;
+    std::lock_guard<std::mutex> guard(packet_lock);
+    return packet_sts.status.value;
 }
 
 uint8_t ChassisBoard::CBDriveMotorInterface::get_Info_Temp(eDrvMotors motorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (motorID == eN_DrvMotor)
         return 0;
-    return packet_MO.mtr_info[motorID].temp;
+    return packet_sts.mtr_info[motorID].temp;
 }   
 
 uint8_t ChassisBoard::CBDriveMotorInterface::get_Info_Current(eDrvMotors motorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (motorID == eN_DrvMotor)
         return 0;
-    return packet_MO.mtr_info[motorID].current;
+    return packet_sts.mtr_info[motorID].current;
 }
 
 float ChassisBoard::CBDriveMotorInterface::get_Info_Pos(eDrvMotors motorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (motorID == eN_DrvMotor)
         return 0;
-    return packet_MO.mtr_info[motorID].position;
+    return packet_sts.mtr_info[motorID].position;
 }
 
 float ChassisBoard::CBDriveMotorInterface::get_Info_Vel(eDrvMotors motorID)
 {
+    std::lock_guard<std::mutex> guard(packet_lock);
     if (motorID == eN_DrvMotor)
         return 0;
-    return packet_MO.mtr_info[motorID].velocity;
+    return packet_sts.mtr_info[motorID].velocity;
 }
 #endif
-
-#ifdef CHASSIS_PRO_MODE
-
-udev_pkt_sens_sts ChassisBoard::CBSensorInterface::get_pro()
-{
-    return packet_SENSO;
-}
-
-void ChassisBoard::CBServoInterface::set_pro(const udev_pkt_srvo_ctrl &send_packet)
-{
-    packet_SI = send_packet;
-}
-
-udev_pkt_srvo_sts ChassisBoard::CBServoInterface::get_pro()
-{
-    return packet_SO;
-}
-
-void ChassisBoard::CBDriveMotorInterface::set_pro(const udev_pkt_drvm_ctrl &send_packet)
-{
-    packet_MI = send_packet;
-}
-
-udev_pkt_drvm_sts ChassisBoard::CBDriveMotorInterface::get_pro()
-{
-    return packet_MO;
-}
-
-#endif
\ No newline at end of file
@@ -2,7 +2,28 @@
 #define CHASSIS_BOARD_H
 
 #include "dependencies/usb_packet.h"
+#include "chassis_async.h"
+#include "chassis_clock.h"
+#include "chassis_endpoint.h"
+#include "chassis_filter.h"
+#include "chassis_mailbox.h"
+#include "chassis_metrics.h"
+#include "chassis_recorder.h"
+#include "chassis_ring.h"
+#include "chassis_scheduler.h"
+#include "chassis_trajectory.h"
+#include "chassis_watchdog.h"
+#include "chassis_transport.h"
 #include <libusb-1.0/libusb.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 /**
  * @file chassis_board.h
@@ -16,6 +37,88 @@
  */
 
 
+//Result callback for the asynchronous interface functions (runs on the event thread)
+using CBResult = std::function<void(libusb_error err)>;
+
+//Per-motor results of a drive batch, indexed by `eDrvMotors`
+using CBDriveBatchResults = std::array<libusb_error, eN_DrvMotor>;
+//Completion callback for a drive batch (runs on the event thread once every motor has completed)
+using CBDriveBatchResult = std::function<void(const CBDriveBatchResults &results)>;
+
+/**
+ * @brief Handler for status notifications.
+ *
+ * @param endpoint Notification endpoint the status arrived on (`DRVM_NTF_EP` or `SRVO_NTF_EP`).
+ * @param status Decoded status, `code` holds an `eDrvStatus` value.
+ */
+using CBStatusHandler = std::function<void(uint8_t endpoint, const udev_status &status)>;
+
+//Snapshot of the traffic counters of one interface
+struct CBInterfaceStats
+{
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+    uint64_t transfers;
+    uint64_t errors;
+};
+
+/**
+ * @brief Receives a completed status packet without copying it (PRO MODE).
+ *
+ * `packet` points into the transfer buffer and is only valid during the call,
+ * it is nullptr when the read failed or came back short.
+ */
+template <typename Packet>
+using CBPacketView = std::function<void(libusb_error err, const Packet *packet)>;
+
+//Read-only view of the last status packet of an interface, holds the interface lock while it lives (PRO MODE)
+template <typename Packet>
+class CBPacketRef
+{
+    public:
+        CBPacketRef(std::mutex &lock, const Packet &packet) : guard(lock), packet(packet) {}
+        const Packet &operator*() const { return packet; }
+        const Packet *operator->() const { return &packet; }
+    private:
+        std::unique_lock<std::mutex> guard;
+        const Packet &packet;
+};
+
+//Counters of the command pump, see `ChassisBoard::start_command_pump()`
+struct CBPumpStats
+{
+    uint64_t posted;    //Commands posted to the mailboxes
+    uint64_t sent;      //Commands written to the board
+    uint64_t coalesced; //Commands replaced by a newer one before they could be sent
+    uint64_t unchanged; //Commands skipped because the board already has the same packet
+};
+
+/**
+ * @brief Receives every complete status packet as it arrives, see `ChassisBoard::set_packet_listener()`.
+ *
+ * Called on the event thread for queued reads and on the reading thread for blocking ones,
+ * so implementations must be thread safe and return quickly.
+ */
+class CBPacketListener
+{
+    public:
+        virtual ~CBPacketListener() = default;
+        virtual void on_packet(const udev_pkt_drvm_sts &packet, uint64_t timestamp_ns) { (void)packet; (void)timestamp_ns; }
+        virtual void on_packet(const udev_pkt_srvo_sts &packet, uint64_t timestamp_ns) { (void)packet; (void)timestamp_ns; }
+        virtual void on_packet(const udev_pkt_sens_sts &packet, uint64_t timestamp_ns) { (void)packet; (void)timestamp_ns; }
+};
+
+//Sensor sample captured by the streaming mode
+struct CBSensorSample
+{
+    //Host steady clock time at which the transfer completed (ns)
+    uint64_t timestamp_ns;
+    uint32_t adc_vals[eN_DrvADC];
+    float adc_volts[eN_DrvADC];
+    //Filter output at the time of the sample (`sequence` is 0 while no filter is set)
+    CBAdcFilterSample filtered;
+};
+
 /**
  * @class ChassisBoard
  * @brief Provides interfaces to communicate with sensors, servos, and drive motors.
@@ -45,8 +148,121 @@
  * 
  * - `CHASSIS_KDBYPASS_SERVO`: Disables the SERVO kernel detaching check.
  * 
- * - `CHASSIS_KDBYPASS_SENSOR`: Disables the SENSOR kernel detaching check.
+ * - `CHASSIS_KDBYPASS_SENSOR`: Disables the SENSOR kernel detaching check. The SENSOR and SERVO share their
+ *   interfaces, so either flag disables the check for both.
+ * 
+ * - `CHASSIS_STRICT_ENDPOINTS`: Fails the build if two interfaces share an endpoint (see `chassis_endpoint.h`).
+ * 
+ *
+ * ### INTERFACES
+ * 
+ * Each interface is described by a `CBEndpoint` (`chassis_endpoint.h`) naming its packets, endpoints and
+ * interface number. Endpoint directions and packet sizes are checked at compile time, and the shared
+ * transfer paths in `CBEndpointInterface` are instantiated per descriptor, so adding an interface means
+ * adding a descriptor and a class exposing the members it supports.
+ *
+ * ### TRANSPORTS
+ * 
+ * All USB I/O goes through a `ChassisTransport`. By default this is `ChassisLibusbTransport`,
+ * passing another transport to the constructor (such as the in-process `ChassisMockBoard`)
+ * runs the same code without the physical board.
+ *
+ * ### COLD START
+ * 
+ * `initialize()` opens the board as soon as it is found, `claimInterfaces()` then only claims (detaching
+ * the kernel driver and claiming in one request where libusb supports it). Saving
+ * `get_startup_stats().bus_path` and passing it to the constructor on the next boot finds the board
+ * without a VID/PID search. `get_startup_stats()` times every step, so a slow or failing start shows
+ * which step to look at.
+ *
+ * ### RECONNECT
+ * 
+ * If the board browns out or the cable is pulled, `ChassisLibusbTransport` notices through libusb
+ * hotplug events (or the first `LIBUSB_ERROR_NO_DEVICE`), calls fail fast with `LIBUSB_ERROR_NO_DEVICE`,
+ * and the board is reopened and claimed again in the background as soon as it enumerates. The sensor
+ * stream and the status listener are re-armed automatically. Outage and reconnect times are reported
+ * by `get_link_stats()`.
+ *
+ * ### ASYNC MODE
+ * 
+ * After `start_async()`, every interface also offers `read_async()`/`write_async()`. These queue
+ * a transfer and return immediately, the result is delivered through a `CBResult` callback or a
+ * `std::future`. Several transfers can be in flight per endpoint, so drive, servo and sensor
+ * traffic overlap. The blocking `read()`/`write()` functions keep working alongside.
+ * Transfer buffers can be placed in device memory so the kernel does not copy packets, and in
+ * PRO MODE `read_view_async()`/`view_pro()` hand out const views instead of copies.
+ * Built as C++20, `chassis_coro.h` adds `co_await cb_await_read(chassis.DrvMtr)` style awaitables with
+ * their own timeout and a `CBCancelToken`, so one thread can keep many operations going without blocking.
+ *
+ * ### SENSOR STREAMING
+ * 
+ * `sensors.start_stream()` keeps reads on `SENS_TXD_EP` permanently re-armed (requires `start_async()`).
+ * Every received sample is stamped with the host steady clock and pushed into a lock-free ring of
+ * `CBSensorInterface::stream_capacity` entries, which one consumer thread drains with `sensors.drain()`.
+ * `sensors.set_filter()` adds a median / moving average / low-pass / decimation pipeline that runs on
+ * every sensor packet as it arrives, its output is published next to the raw values.
+ *
+ * ### STATUS NOTIFICATIONS
+ * 
+ * `start_status_listener()` claims the notification interfaces and keeps interrupt reads armed on
+ * `DRVM_NTF_EP` and `SRVO_NTF_EP` (requires `start_async()`). Whenever the reported `udev_status`
+ * changes, every handler registered with `add_status_handler()` is called, so conditions such as
+ * `eDrvStall` or `eDrvMtrFail` no longer need to be polled through `DrvMtr.read()`.
+ *
+ * ### COMMAND MAILBOXES
+ * 
+ * `DrvMtr.post()` and `servos.post()` drop a control packet into a lock-free mailbox per motor / servo,
+ * replacing any command not sent yet. Any number of threads may post. `start_command_pump()` sends
+ * the newest command of every mailbox at a fixed rate, keeps at most one command per motor / servo
+ * in flight, and skips commands identical to the last one sent, so bursts of updates never queue up
+ * stale packets on the bus.
+ *
+ * ### SERVO TRAJECTORIES
+ * 
+ * `ChassisServoTrajectory::build()` precomputes linear, cubic or minimum jerk setpoints between
+ * waypoints, `servos.play()` streams them to `SRVO_RXD_EP` at the trajectory rate from a player thread.
+ *
+ * ### MULTIPLE BOARDS
+ *
+ * The default constructor finds the first board on a private libusb context. To drive several boards,
+ * open them through a `ChassisBoardManager` (`chassis_manager.h`), which picks boards by serial number
+ * or bus path and services all of them from one context and one event thread.
+ *
+ * ### OTHER PROCESSES
+ *
+ * Only one process can claim the board. A `ChassisDaemon` (`chassis_daemon.h`, or the `chassisd` tool)
+ * owns it and shares it through shared memory: other processes read the latest status packets and
+ * queue commands with a `ChassisShmClient`, without a system call. `set_packet_listener()` is the
+ * hook the daemon publishes from.
+ *
+ * ### METRICS
+ * 
+ * Every transfer is counted per endpoint (transfers, timeouts, errors by `libusb_error`, bytes and a
+ * latency histogram) with a few relaxed atomic increments. `get_metrics()` returns a snapshot and
+ * `start_metrics_export()` keeps a Prometheus text file up to date for alerting on bus degradation.
+ *
+ * ### WATCHDOG
+ * 
+ * `start_watchdog()` checks on its own thread (optionally `SCHED_FIFO`) that drive writes and reads keep
+ * succeeding within their deadlines and that the drive board does not report `eDrvStall` / `eDrvMtrFail`.
+ * On a miss it immediately writes a prebuilt `enable = 0` packet for every drive motor, so a hung control
+ * process or a stalled board stops the motors within a few milliseconds. Until it clears, drive writes are
+ * refused so a running control loop cannot re-enable them.
+ *
+ * ### QUALITY OF SERVICE
+ * 
+ * `set_qos()` bounds the transfers on the bus and queues the rest by class: drive commands, then servo
+ * commands, then status and sensor reads, each with an optional rate budget. A drive command never waits
+ * behind queued telemetry, only for a place on the bus. While the scheduler is on, blocking `read()` /
+ * `write()` calls queue through it as well (and refuse to block the event thread). `get_qos_stats()` reports the queueing delay of every class.
+ *
+ * ### THREAD SAFETY
  * 
+ * `sensors`, `servos` and `DrvMtr` each guard their packets with their own lock, which is never held
+ * across a USB transfer, so one thread per interface can run without contending with the others.
+ * Each interface also keeps atomic byte, transfer and error counters (`get_stats()`).
+ * Setting a field and calling `write()` are separate steps, so threads sharing one interface must
+ * still agree on who builds the packet (or use `set_pro()`).
  *
  * ### PRO MODE
  * 
@@ -62,73 +278,288 @@
 class ChassisBoard
 {
     private:
-        static constexpr uint16_t B_VID = 0xFFFE;
-        static constexpr uint16_t B_PID = 0xD415;
-        int bytes_recv = 0;
-        int bytes_sent = 0;
+        std::atomic<int> bytes_recv{0};
+        std::atomic<int> bytes_sent{0};
         static constexpr int timeout = 100; //ms
-        libusb_context *ctx = nullptr;
-        libusb_device **list_of_devices = nullptr;
-        libusb_device *device = nullptr; 
-        libusb_device_descriptor *device_desc = nullptr; 
-        libusb_device_handle *handle = nullptr;
+        std::unique_ptr<ChassisTransport> owned_transport; //Default libusb transport
+        ChassisTransport *transport;
+        ChassisAsyncEngine async_engine;
+        std::mutex status_lock;
+        std::vector<std::pair<int, CBStatusHandler>> status_handlers;
+        int next_handler_id = 0;
+        std::atomic<bool> status_listening{false};
+        bool ntf_claimed = false;
+        //Mailbox and send state of one motor / servo, the send state belongs to the pump thread
+        template <typename Packet>
+        struct CBPumpChannel
+        {
+            ChassisMailbox<Packet> mailbox;
+            Packet wanted;
+            bool has_wanted = false;
+            bool fresh = false; //`wanted` was taken and not evaluated yet
+            Packet sent;
+            bool sent_valid = false;
+            std::atomic<bool> in_flight{false};
+            std::atomic<bool> failed{false};
+        };
+        std::unique_ptr<ChassisLoopScheduler> command_pump;
+        std::atomic<uint64_t> pump_sent{0};
+        std::atomic<uint64_t> pump_coalesced{0};
+        std::atomic<uint64_t> pump_unchanged{0};
+        //Trajectory played on one servo, see `CBServoInterface::play()`
+        struct CBTrajectoryTrack
+        {
+            std::shared_ptr<const ChassisServoTrajectory> trajectory;
+            uint64_t start_ns = 0;
+            size_t last_sent = SIZE_MAX;
+            bool in_flight = false;
+        };
+        std::mutex player_lock; //Starting and stopping the player
+        std::unique_ptr<ChassisLoopScheduler> trajectory_player;
+        udev_status last_drvm_status = {0xFF, 0xFF}; //0xFF = nothing received yet
+        udev_status last_srvo_status = {0xFF, 0xFF};
+        struct CBInterfaceCounters
+        {
+            std::atomic<uint64_t> bytes_sent{0};
+            std::atomic<uint64_t> bytes_recv{0};
+            std::atomic<uint64_t> transfers{0};
+            std::atomic<uint64_t> errors{0};
+            CBInterfaceStats snapshot() const;
+        };
+        std::atomic<ChassisRecorder*> recorder{nullptr};
+        ChassisMetrics metrics;
+        ChassisWatchdog watchdog;
+        udev_pkt_drvm_ctrl failsafe_packets[eN_DrvMotor]; //Built by `start_watchdog()`
+        //Sends the disable packets with blocking transfers, outside of any queue
+        libusb_error send_failsafe(unsigned int timeout_ms);
+        //Refuses drive writes while the watchdog is tripped, the attempt still counts as drive traffic
+        bool write_blocked(uint8_t endpoint);
+        //Bookkeeping for every completed transfer: counters, metrics, last transfer sizes and the recorder
+        void account(CBInterfaceCounters &counters, uint8_t endpoint, int err, const void *data, int length, uint64_t start_ns);
+        libusb_error arm_status_read(uint8_t endpoint);
+        void on_link_change(bool connected);
+        template <typename Packet>
+        void pump_channel(CBPumpChannel<Packet> &channel, CBInterfaceCounters &counters, uint8_t endpoint);
+        //One cycle of the trajectory player: sends the setpoint due on every servo with a trajectory
+        void play_trajectories();
+        void dispatch_status(uint8_t endpoint, const udev_status &status);
+        std::atomic<CBPacketListener*> packet_listener{nullptr};
+        //Runs on every complete status packet as it arrives
+        template <typename Packet>
+        void on_status_packet(const Packet &packet)
+        {
+            CBPacketListener *listener = packet_listener.load(std::memory_order_acquire);
+            if (listener)
+                listener->on_packet(packet, cb_now_ns());
+        }
+        void on_status_packet(const udev_pkt_sens_sts &packet);
+        void on_status_packet(const udev_pkt_drvm_sts &packet);
 
-        class CBSensorInterface
+        /**
+         * @brief Transfer paths shared by every data interface, generated from its `CBEndpoint` descriptor.
+         *
+         * Defined in this header so each interface gets its own fully inlined copy, with the endpoints
+         * and packet sizes as constants. The interfaces below re-export the members they support.
+         */
+        template <typename Desc>
+        class CBEndpointInterface
         {
-            private:
+            static_assert(Desc::max_packet <= ChassisAsyncEngine::buffer_size, "Endpoint packets exceed the async transfer buffers");
+            protected:
+                using ctrl_packet = typename Desc::ctrl_packet;
+                using sts_packet = typename Desc::sts_packet;
                 ChassisBoard& chassis;
-                int err;
-                //udev_pkt_sens_ctrl packet_SENSI; //Sensor in packet (useless)
-                udev_pkt_sens_sts packet_SENSO; //Sensor out packet
-            public:
-                CBSensorInterface(ChassisBoard& chassis_ref) : chassis(chassis_ref) {}
-                //libusb_error write(); //This is useless as the packet cannot send anything
+                mutable std::mutex packet_lock;
+                CBInterfaceCounters counters;
+                ctrl_packet packet_ctrl = {}; //Host to board packet
+                sts_packet packet_sts = {};   //Board to host packet
+                CBEndpointInterface(ChassisBoard& chassis_ref) : chassis(chassis_ref) {}
+                libusb_error write();
                 libusb_error read();
+                CBInterfaceStats get_stats() const;
+                //Queues a write of the current packet (requires `start_async()`)
+                libusb_error write_async(CBResult callback);
+                std::future<libusb_error> write_async();
+                //Queues a read, the packet is updated before the callback runs (requires `start_async()`)
+                libusb_error read_async(CBResult callback);
+                std::future<libusb_error> read_async();
+                //Same with a timeout of its own, `ticket` identifies the transfer for `cancel()`
+                libusb_error write_async(CBResult callback, unsigned int timeout_ms, CBTransferTicket *ticket);
+                libusb_error read_async(CBResult callback, unsigned int timeout_ms, CBTransferTicket *ticket);
+                //Cancels one queued transfer, its callback reports `LIBUSB_ERROR_INTERRUPTED`
+                void cancel(const CBTransferTicket &ticket);
+                #ifdef CHASSIS_PRO_MODE
+                void set_pro(const ctrl_packet &send_packet);
+                sts_packet get_pro();
+                //Zero-copy forms of get_pro() and read_async(), a viewed read does not update the stored packet
+                CBPacketRef<sts_packet> view_pro() const;
+                libusb_error read_view_async(CBPacketView<sts_packet> callback);
+                #endif
+        };
+
+        class CBSensorInterface : protected CBEndpointInterface<CBSensorEndpoint>
+        {
+            public:
+                static constexpr size_t stream_capacity = 1024;
+            private:
+                ChassisSPSCRing<CBSensorSample, stream_capacity> stream_ring;
+                std::atomic<bool> streaming{false};
+                std::atomic<int> stream_armed{0};
+                std::atomic<int> stream_depth{0};
+                std::atomic<uint64_t> stream_dropped{0};
+                ChassisAdcFilter filter;
+                libusb_error arm_stream_read();
+                //Re-arms the reads a reconnect cost the stream
+                void resume_stream();
+                friend class ChassisBoard;
+            public:
+                CBSensorInterface(ChassisBoard& chassis_ref) : CBEndpointInterface(chassis_ref) {}
+                //No write(), the sensor control packet is empty
+                using CBEndpointInterface::read;
+                using CBEndpointInterface::get_stats;
+                using CBEndpointInterface::read_async;
+                using CBEndpointInterface::cancel;
+                /**
+                 * @brief Starts continuous sensor streaming into the sample ring.
+                 *
+                 * @param depth Number of reads kept in flight on `SENS_TXD_EP`, including those of a stopped
+                 *              stream that have not finished yet.
+                 *
+                 * @return `LIBUSB_SUCCESS` if at least one read was armed, `LIBUSB_ERROR_BUSY` if already
+                 *         streaming, otherwise the error of the first failed submission.
+                 */
+                libusb_error start_stream(int depth = 2);
+                //Stops re-arming reads, the ones in flight finish within `timeout`
+                void stop_stream();
+                bool is_streaming();
+                //Copies up to `max` samples (oldest first) into `out`. Single consumer, lock and allocation free.
+                size_t drain(CBSensorSample *out, size_t max);
+                //Number of samples lost because the ring was full
+                uint64_t get_dropped();
+                /**
+                 * @brief Filters every sensor packet as it arrives (blocking, queued and streamed reads).
+                 *
+                 * All ADC channels and the temperature are filtered together, the filtered values are
+                 * published next to the raw packet (`get_filtered()`, `CBSensorSample::filtered`).
+                 * Calling it again restarts the filter with the new stages.
+                 *
+                 * @return `LIBUSB_SUCCESS`, or `LIBUSB_ERROR_INVALID_PARAM` if a stage is out of range.
+                 */
+                libusb_error set_filter(const CBAdcFilterConfig &config);
+                CBAdcFilterConfig get_filter();
+                //Latest filtered sample, false until the filter has published one
+                bool get_filtered(CBAdcFilterSample &sample);
                 #ifndef CHASSIS_RMV_EZ_MODE
                 //Get packet EZ MODE
                 uint32_t get_ADCVals(eChassisADC sensorID);
                 float get_ADCVolts(eChassisADC sensorID);
+                //Latest filtered values (requires `set_filter()`, 0 before the first one is published)
+                float get_ADCFilteredVals(eChassisADC sensorID);
+                float get_ADCFilteredVolts(eChassisADC sensorID);
                 #endif
                 #ifdef CHASSIS_PRO_MODE
-                udev_pkt_sens_sts get_pro();
+                using CBEndpointInterface::get_pro;
+                using CBEndpointInterface::view_pro;
+                using CBEndpointInterface::read_view_async;
                 #endif
         };
-        class CBServoInterface
+        class CBServoInterface : protected CBEndpointInterface<CBServoEndpoint>
         {
             private:
-                ChassisBoard& chassis;
-                int err;
-                udev_pkt_srvo_ctrl packet_SI; //Servo in packet
-                udev_pkt_srvo_sts packet_SO; //Servo out packet
+                CBPumpChannel<udev_pkt_srvo_ctrl> channels[eN_Servo];
+                std::mutex track_lock;
+                CBTrajectoryTrack tracks[eN_Servo];
+                friend class ChassisBoard;
             public:
-                CBServoInterface(ChassisBoard& chassis_ref) : chassis(chassis_ref) {}
-                libusb_error write();
-                libusb_error read();
+                CBServoInterface(ChassisBoard& chassis_ref) : CBEndpointInterface(chassis_ref) {}
+                using CBEndpointInterface::write;
+                using CBEndpointInterface::read;
+                using CBEndpointInterface::get_stats;
+                using CBEndpointInterface::write_async;
+                using CBEndpointInterface::read_async;
+                using CBEndpointInterface::cancel;
+                /**
+                 * @brief Posts a command to the mailbox of servo `packet.srvo_id`, sent by the command pump.
+                 *
+                 * Lock-free, a command not sent yet is replaced.
+                 *
+                 * @return `LIBUSB_SUCCESS`, or `LIBUSB_ERROR_INVALID_PARAM` for an unknown servo.
+                 */
+                libusb_error post(const udev_pkt_srvo_ctrl &packet);
+                //Posts the current packet (as built with the setters)
+                libusb_error post();
+                /**
+                 * @brief Streams a precomputed trajectory to its servo from the board's player thread.
+                 *
+                 * The player sends the setpoint due at every tick of the trajectory rate (queued writes after
+                 * `start_async()`, blocking ones otherwise), the calling thread does no further work. A late
+                 * tick skips ahead instead of falling behind. Replaces a trajectory already playing on the servo.
+                 * Do not post commands for the same servo while it plays.
+                 *
+                 * @return `LIBUSB_SUCCESS`, `LIBUSB_ERROR_INVALID_PARAM` for an empty trajectory or one whose rate
+                 *         differs from the trajectories playing, `LIBUSB_ERROR_OTHER` if the player could not start.
+                 */
+                libusb_error play(const ChassisServoTrajectory &trajectory);
+                //Stops the trajectory of a servo, the servo holds the last setpoint sent
+                void stop_trajectory(eChassisServo servo);
+                bool is_playing(eChassisServo servo);
                 #ifndef CHASSIS_RMV_EZ_MODE
                 //Set packet EZ MODE
                 void set_ID(eChassisServo servoID);
                 void set_CTRL(uint32_t servoCTRL);
                 //Get packet EZ MODE
                 uint8_t get_Len();
+                //Points into the live packet, only stable while no read of this interface is running
                 const uint8_t* get_Buf();
                 float get_Temp();
                 #endif
                 #ifdef CHASSIS_PRO_MODE
-                void set_pro(const udev_pkt_srvo_ctrl &send_packet);
-                udev_pkt_srvo_sts get_pro();
+                using CBEndpointInterface::set_pro;
+                using CBEndpointInterface::get_pro;
+                using CBEndpointInterface::view_pro;
+                using CBEndpointInterface::read_view_async;
                 #endif
         };
-        class CBDriveMotorInterface
+        class CBDriveMotorInterface : protected CBEndpointInterface<CBDriveMotorEndpoint>
         {
             private:
-                ChassisBoard& chassis;
-                int err;
-                udev_pkt_drvm_ctrl packet_MI; //Motor in packet
-                udev_pkt_drvm_sts packet_MO; //Motor out packet
+                CBPumpChannel<udev_pkt_drvm_ctrl> channels[eN_DrvMotor];
+                friend class ChassisBoard;
             public:
-                CBDriveMotorInterface(ChassisBoard& chassis_ref) : chassis(chassis_ref) {}
-                libusb_error write();
-                libusb_error read();
+                CBDriveMotorInterface(ChassisBoard& chassis_ref) : CBEndpointInterface(chassis_ref) {}
+                using CBEndpointInterface::write;
+                using CBEndpointInterface::read;
+                using CBEndpointInterface::get_stats;
+                using CBEndpointInterface::write_async;
+                using CBEndpointInterface::read_async;
+                using CBEndpointInterface::cancel;
+                /**
+                 * @brief Sends setpoints for every drive motor as one pipelined burst.
+                 *
+                 * One `udev_pkt_drvm_ctrl` per motor is queued back to back on `DRVM_RXD_EP`
+                 * (`mtr_id` is filled in from the array index, `light_ctrl` from the current packet).
+                 * Requires `start_async()` with a queue depth of at least `eN_DrvMotor`.
+                 *
+                 * @param setpoints Motor control values indexed by `eDrvMotors`.
+                 * @param callback Receives the result of every motor once all of them have completed.
+                 *                 Motors that could not be queued report the submission error.
+                 *
+                 * @return `LIBUSB_SUCCESS` if every packet was queued, otherwise the first submission error.
+                 *         The callback is invoked in both cases.
+                 */
+                libusb_error write_batch(const udev_mtr_ctrl (&setpoints)[eN_DrvMotor], CBDriveBatchResult callback);
+                //Blocking form of the batch write, waits for every motor and fills `results` (not from a callback)
+                libusb_error write_batch(const udev_mtr_ctrl (&setpoints)[eN_DrvMotor], CBDriveBatchResults &results);
+                /**
+                 * @brief Posts a command to the mailbox of motor `packet.mtr_id`, sent by the command pump.
+                 *
+                 * Lock-free, a command not sent yet is replaced.
+                 *
+                 * @return `LIBUSB_SUCCESS`, or `LIBUSB_ERROR_INVALID_PARAM` for an unknown motor.
+                 */
+                libusb_error post(const udev_pkt_drvm_ctrl &packet);
+                //Posts the current packet (as built with the setters)
+                libusb_error post();
                 #ifndef CHASSIS_RMV_EZ_MODE
                 //Set packet EZ MODE
                 void set_ID(eDrvMotors mtrID);
@@ -173,8 +604,10 @@ class ChassisBoard
                 float get_Info_Vel(eDrvMotors motorID);
                 #endif
                 #ifdef CHASSIS_PRO_MODE
-                void set_pro(const udev_pkt_drvm_ctrl &send_packet);
-                udev_pkt_drvm_sts get_pro();
+                using CBEndpointInterface::set_pro;
+                using CBEndpointInterface::get_pro;
+                using CBEndpointInterface::view_pro;
+                using CBEndpointInterface::read_view_async;
                 #endif
         };
 
@@ -182,7 +615,22 @@ class ChassisBoard
         CBSensorInterface sensors;
         CBServoInterface servos;
         CBDriveMotorInterface DrvMtr;
+        //Talks to the physical board through libusb
         ChassisBoard();
+        /**
+         * @brief Performs all I/O through `transport` instead of libusb, e.g. a `ChassisMockBoard`.
+         *
+         * The transport must outlive the board. `initialize()` and `claimInterfaces()` are still
+         * required and are forwarded to the transport.
+         */
+        explicit ChassisBoard(ChassisTransport &transport);
+        /**
+         * @brief Talks to the physical board through libusb, trying the board at `bus_path` first.
+         *
+         * Pass the `CBStartupStats::bus_path` saved from an earlier start to skip the VID/PID search,
+         * any board is used if none is found there.
+         */
+        explicit ChassisBoard(const std::string &bus_path);
         /**
          * @brief Initializes the libusb context and detects the chassis board.
          *
@@ -196,7 +644,8 @@ class ChassisBoard
          *
          * @return `LIBUSB_SUCCESS` if initialization is successful.  
          *         Otherwise, returns a libusb error code (e.g., `LIBUSB_ERROR_NO_DEVICE`  
-         *         if the board is not found, or `LIBUSB_ERROR_OTHER` for general failures).
+         *         if the board is not found, `LIBUSB_ERROR_ACCESS` if it may not be opened,
+         *         or `LIBUSB_ERROR_OTHER` for general failures). `get_startup_stats()` names the failed step.
          *
          * @note If initialization fails, USB communication with the board will not be possible.
          *       Ensure libusb is properly installed and that the board is connected.
@@ -220,6 +669,131 @@ class ChassisBoard
          * 
          */
         libusb_error claimInterfaces();
+
+        /**
+         * @brief Starts the asynchronous transfer engine and its event thread.
+         *
+         * Must be called after `claimInterfaces()`. Each data endpoint gets `queue_depth`
+         * preallocated transfers, which bounds how many requests can be queued on it at once.
+         * When the queue of an endpoint is full, the `*_async()` functions return `LIBUSB_ERROR_BUSY`.
+         *
+         * @param queue_depth Transfers kept per endpoint (1 to `ChassisAsyncEngine::max_queue_depth`).
+         * @param device_memory Backs the transfer buffers with `libusb_dev_mem_alloc()` memory where the
+         *                      kernel supports it (no kernel copy per packet), regular aligned memory otherwise.
+         *
+         * @return `LIBUSB_SUCCESS` on success.  
+         *         Otherwise, returns a libusb error code.
+         */
+        libusb_error start_async(int queue_depth = 4, bool device_memory = false);
+
+        //Cancels pending asynchronous transfers and stops the event thread (called by the destructor).
+        //Returns `LIBUSB_ERROR_BUSY` without stopping when called from a completion callback.
+        libusb_error stop_async();
+        /**
+         * @brief Routes the bulk transfers through the priority scheduler (see QUALITY OF SERVICE).
+         *
+         * Can be called at any time, `max_in_flight = 0` turns the scheduler off again.
+         * Notification reads bypass it. Requires `start_async()` to take effect.
+         *
+         * @note While it is on, the blocking `read()` / `write()` wait for the event thread, so called from the
+         *       event thread itself (completion callbacks, status handlers, coroutines resumed by a transfer)
+         *       they return `LIBUSB_ERROR_BUSY`. Use the `*_async()` functions there.
+         *
+         * @return `LIBUSB_SUCCESS`, `LIBUSB_ERROR_INVALID_PARAM` for a negative bound or rate budget.
+         */
+        libusb_error set_qos(const CBQosConfig &config);
+        CBQosConfig get_qos();
+        //Transfers, queueing and mean / maximum queueing delay of every priority class
+        CBQosStats get_qos_stats();
+
+        /**
+         * @brief Starts listening on the interrupt notification endpoints.
+         *
+         * Claims the drive and servo notification interfaces (detaching kernel drivers unless the
+         * matching `CHASSIS_KDBYPASS_*` flag is defined) and arms an interrupt read on each one.
+         * Requires `start_async()`.
+         *
+         * @return `LIBUSB_SUCCESS` on success, `LIBUSB_ERROR_BUSY` if already listening.  
+         *         Otherwise, returns a libusb error code.
+         */
+        libusb_error start_status_listener();
+        //Stops re-arming the notification reads and cancels the ones in flight
+        void stop_status_listener();
+        /**
+         * @brief Registers a handler called (on the event thread) whenever a notified status changes.
+         *
+         * @return Id to pass to `remove_status_handler()`.
+         */
+        int add_status_handler(CBStatusHandler handler);
+        void remove_status_handler(int handler_id);
+        /**
+         * @brief Records every transfer of every interface (blocking and asynchronous) into `rec`.
+         *
+         * Sent control packets, received status packets and notifications are appended with their
+         * completion time, duration, endpoint and result. Pass `nullptr` to stop recording. The recorder
+         * must outlive any transfer started while it is attached. `ChassisReplayTransport` plays a
+         * recording back in place of the board.
+         */
+        void attach_recorder(ChassisRecorder *rec);
+        /**
+         * @brief Transfer metrics of every endpoint used so far.
+         *
+         * Transfer, timeout and per-`libusb_error` counts, payload bytes, a latency histogram and the
+         * throughput since the previous call (of this or of the exporter).
+         */
+        std::vector<CBEndpointMetrics> get_metrics();
+        /**
+         * @brief Rewrites `path` with the transfer metrics in the Prometheus text format every `interval_ms`.
+         *
+         * Point the node exporter textfile collector at the directory to scrape them.
+         *
+         * @param labels Extra labels for every sample, e.g. `board="front"`.
+         * @return 0 on success, `EBUSY` if already exporting, `EINVAL` for a zero interval.
+         */
+        int start_metrics_export(const char *path, unsigned interval_ms, const std::string &labels = std::string());
+        void stop_metrics_export();
+        /**
+         * @brief Passes every complete status packet of every interface to `listener` as it arrives.
+         *
+         * Pass `nullptr` to remove it. The listener must outlive any read started while it is set.
+         */
+        void set_packet_listener(CBPacketListener *listener);
+        //Connection state, disconnect count and reconnect latency of the transport
+        CBLinkStats get_link_stats();
+        //Time spent in every step of `initialize()` and `claimInterfaces()`, and the step that failed
+        CBStartupStats get_startup_stats();
+        /**
+         * @brief Starts sending the posted drive and servo commands at `rate_hz` (the bus rate).
+         *
+         * Every cycle the newest command of each mailbox is written if it differs from the last one
+         * sent to that motor / servo. Uses queued writes after `start_async()`, blocking ones otherwise.
+         *
+         * @return 0 on success, `EBUSY` if already running, otherwise the error of `ChassisLoopScheduler::start()`.
+         */
+        int start_command_pump(double rate_hz);
+        /**
+         * @brief Starts the drive watchdog (see WATCHDOG).
+         *
+         * Once a deadline is missed or a bad status arrives, a disable packet (`enable = 0`) is written to
+         * every `eDrvMotors` with blocking transfers from the watchdog thread, then `handler` is called.
+         * The watchdog rearms by itself once drive traffic meets its deadlines again. With the command
+         * pump, unchanged commands are not resent: call `feed_watchdog()` from the control loop instead.
+         *
+         * While tripped, queued drive writes are cancelled and every new one (`write()`, `write_async()`,
+         * `write_batch()`, the command pump) is refused with `LIBUSB_ERROR_ACCESS` instead of re-enabling the
+         * motors. A write deadline trip clears at the next check after the control loop tries to write again,
+         * a status trip only once the drive board reports a good status. The command pump then sends the
+         * posted drive commands again, even unchanged ones.
+         *
+         * @return 0 on success, `EBUSY` if already running, otherwise the error of `ChassisWatchdog::start()`.
+         */
+        int start_watchdog(const CBWatchdogConfig &config, CBWatchdogHandler handler = nullptr);
+        void stop_watchdog();
+        //Counts as a successful drive write for the write deadline
+        void feed_watchdog();
+        CBWatchdogStats get_watchdog_stats();
+        void stop_command_pump();
+        CBPumpStats get_pump_stats();
         //Returns the number of bytes received after a write operation.
         int get_bytes_recv();
         //Returns the number of bytes send after a read operation
@@ -227,4 +801,175 @@ class ChassisBoard
         ~ChassisBoard();
 };
 
-#endif
\ No newline at end of file
+//Interface transfer paths, packets are transferred through a local copy so the packet lock is never held during I/O
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::write()
+{
+    static_assert(Desc::writable, "This interface has no control packet to write");
+    if (chassis.write_blocked(Desc::out_ep))
+        return LIBUSB_ERROR_ACCESS;
+    if (chassis.async_engine.qos_enabled())
+    {
+        //Queued so the scheduler orders it against the asynchronous traffic, sent directly if the queue is full.
+        //The event thread would wait for its own completion
+        if (ChassisAsyncEngine::on_event_thread())
+            return LIBUSB_ERROR_BUSY;
+        std::promise<libusb_error> done;
+        std::future<libusb_error> result = done.get_future();
+        if (write_async([&done](libusb_error cb_err) { done.set_value(cb_err); }) == LIBUSB_SUCCESS)
+            return result.get();
+    }
+    ctrl_packet packet;
+    {
+        std::lock_guard<std::mutex> guard(packet_lock);
+        packet = packet_ctrl;
+    }
+    int length = 0;
+    uint64_t start_ns = cb_now_ns();
+    int err = chassis.transport->transfer(Desc::out_ep, (unsigned char *)&packet, sizeof(packet), &length, timeout);
+    chassis.account(counters, Desc::out_ep, err, &packet, length, start_ns);
+    return (libusb_error)err;
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::read()
+{
+    if (chassis.async_engine.qos_enabled())
+    {
+        if (ChassisAsyncEngine::on_event_thread())
+            return LIBUSB_ERROR_BUSY;
+        std::promise<libusb_error> done;
+        std::future<libusb_error> result = done.get_future();
+        if (read_async([&done](libusb_error cb_err) { done.set_value(cb_err); }) == LIBUSB_SUCCESS)
+            return result.get();
+    }
+    sts_packet packet;
+    int length = 0;
+    uint64_t start_ns = cb_now_ns();
+    int err = chassis.transport->transfer(Desc::in_ep, (unsigned char *)&packet, sizeof(packet), &length, timeout);
+    chassis.account(counters, Desc::in_ep, err, &packet, length, start_ns);
+    if (err == LIBUSB_SUCCESS)
+    {
+        if (length == (int)sizeof(packet))
+            chassis.on_status_packet(packet);
+        std::lock_guard<std::mutex> guard(packet_lock);
+        copy_packet(packet_sts, (const unsigned char *)&packet, length);
+    }
+    return (libusb_error)err;
+}
+
+template <typename Desc>
+inline CBInterfaceStats ChassisBoard::CBEndpointInterface<Desc>::get_stats() const
+{
+    return counters.snapshot();
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::write_async(CBResult callback)
+{
+    return write_async(callback, timeout, nullptr);
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::write_async(CBResult callback, unsigned int timeout_ms, CBTransferTicket *ticket)
+{
+    static_assert(Desc::writable, "This interface has no control packet to write");
+    if (chassis.write_blocked(Desc::out_ep))
+        return LIBUSB_ERROR_ACCESS;
+    std::unique_lock<std::mutex> guard(packet_lock);
+    ctrl_packet packet = packet_ctrl;
+    guard.unlock();
+    uint64_t start_ns = cb_now_ns();
+    return chassis.async_engine.submit_out(Desc::out_ep, &packet, sizeof(packet), timeout_ms,
+        [this, start_ns, callback](libusb_error cb_err, const unsigned char *data, int length) {
+            chassis.account(counters, Desc::out_ep, cb_err, data, length, start_ns);
+            if (callback)
+                callback(cb_err);
+        }, ticket);
+}
+
+template <typename Desc>
+inline std::future<libusb_error> ChassisBoard::CBEndpointInterface<Desc>::write_async()
+{
+    return submit_as_future([this](CBResult callback) { return write_async(callback); });
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::read_async(CBResult callback)
+{
+    return read_async(callback, timeout, nullptr);
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::read_async(CBResult callback, unsigned int timeout_ms, CBTransferTicket *ticket)
+{
+    uint64_t start_ns = cb_now_ns();
+    return chassis.async_engine.submit_in(Desc::in_ep, sizeof(sts_packet), timeout_ms,
+        [this, start_ns, callback](libusb_error cb_err, const unsigned char *data, int length) {
+            chassis.account(counters, Desc::in_ep, cb_err, data, length, start_ns);
+            if (cb_err == LIBUSB_SUCCESS)
+            {
+                if (const sts_packet *packet = packet_view<sts_packet>(cb_err, data, length))
+                    chassis.on_status_packet(*packet);
+                std::lock_guard<std::mutex> guard(packet_lock);
+                copy_packet(packet_sts, data, length);
+            }
+            if (callback)
+                callback(cb_err);
+        }, ticket);
+}
+
+template <typename Desc>
+inline std::future<libusb_error> ChassisBoard::CBEndpointInterface<Desc>::read_async()
+{
+    return submit_as_future([this](CBResult callback) { return read_async(callback); });
+}
+
+template <typename Desc>
+inline void ChassisBoard::CBEndpointInterface<Desc>::cancel(const CBTransferTicket &ticket)
+{
+    chassis.async_engine.cancel(ticket);
+}
+
+#ifdef CHASSIS_PRO_MODE
+
+template <typename Desc>
+inline void ChassisBoard::CBEndpointInterface<Desc>::set_pro(const ctrl_packet &send_packet)
+{
+    static_assert(Desc::writable, "This interface has no control packet to set");
+    std::lock_guard<std::mutex> guard(packet_lock);
+    packet_ctrl = send_packet;
+}
+
+template <typename Desc>
+inline typename Desc::sts_packet ChassisBoard::CBEndpointInterface<Desc>::get_pro()
+{
+    std::lock_guard<std::mutex> guard(packet_lock);
+    return packet_sts;
+}
+
+template <typename Desc>
+inline CBPacketRef<typename Desc::sts_packet> ChassisBoard::CBEndpointInterface<Desc>::view_pro() const
+{
+    return CBPacketRef<sts_packet>(packet_lock, packet_sts);
+}
+
+template <typename Desc>
+inline libusb_error ChassisBoard::CBEndpointInterface<Desc>::read_view_async(CBPacketView<sts_packet> callback)
+{
+    uint64_t start_ns = cb_now_ns();
+    return chassis.async_engine.submit_in(Desc::in_ep, sizeof(sts_packet), timeout,
+        [this, start_ns, callback](libusb_error cb_err, const unsigned char *data, int length) {
+            chassis.account(counters, Desc::in_ep, cb_err, data, length, start_ns);
+            const sts_packet *packet = packet_view<sts_packet>(cb_err, data, length);
+            if (packet)
+                chassis.on_status_packet(*packet);
+            if (callback)
+                callback(cb_err, packet);
+        });
+}
+
+#endif
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CHASSIS_CLOCK_H
+#define CHASSIS_CLOCK_H
+
+#include <cstdint>
+#include <time.h>
+
+/**
+ * @file chassis_clock.h
+ * @author Kian Cossettini
+ * @brief Host monotonic clock shared by the chassis components
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Returns the `CLOCK_MONOTONIC` time in ns (same clock as `std::chrono::steady_clock` on Linux)
+inline uint64_t cb_now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef CHASSIS_CORO_H
+#define CHASSIS_CORO_H
+
+#include "chassis_board.h"
+
+/**
+ * @file chassis_coro.h
+ * @author Kian Cossettini
+ * @brief C++20 awaitable reads and writes for the chassis interfaces
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Only available when compiled as C++20 (or later), the rest of the library stays C++17
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define CHASSIS_COROUTINES
+
+//Shared between an awaiting transfer and the tokens able to cancel it
+struct CBAwaitState
+{
+    std::mutex lock;
+    CBTransferTicket ticket;
+    bool done = false;
+    bool cancelled = false;
+    std::function<void(const CBTransferTicket &ticket)> cancel;
+};
+
+/**
+ * @class CBCancelToken
+ * @brief Cancels the chassis transfers awaited with it.
+ *
+ * One token can be passed to any number of awaits, e.g. every transfer of one behavior. `cancel()`
+ * interrupts those in flight and makes later awaits complete right away, until `reset()`.
+ * Thread safe, and may be called from a coroutine running on the event thread.
+ */
+class CBCancelToken
+{
+    public:
+        void cancel()
+        {
+            std::vector<std::shared_ptr<CBAwaitState>> cancelling;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                cancelled = true;
+                for (std::weak_ptr<CBAwaitState> &entry : waiting)
+                    if (std::shared_ptr<CBAwaitState> state = entry.lock())
+                        cancelling.push_back(state);
+                waiting.clear();
+            }
+            for (std::shared_ptr<CBAwaitState> &state : cancelling)
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                state->cancelled = true;
+                //A ticket without a slot means the transfer is not submitted yet, it sees `cancelled` instead
+                if (!state->done && state->ticket.slot)
+                    state->cancel(state->ticket);
+            }
+        }
+
+        bool is_cancelled() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return cancelled;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            cancelled = false;
+        }
+
+    private:
+        mutable std::mutex lock;
+        bool cancelled = false;
+        std::vector<std::weak_ptr<CBAwaitState>> waiting;
+
+        //Returns false if the token is already cancelled
+        bool attach(const std::shared_ptr<CBAwaitState> &state)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (cancelled)
+                return false;
+            //Drop the transfers that completed since, so a long lived token does not grow
+            for (size_t i = 0; i < waiting.size();)
+            {
+                if (waiting[i].expired())
+                {
+                    waiting[i] = waiting.back();
+                    waiting.pop_back();
+                }
+                else
+                    i++;
+            }
+            waiting.push_back(state);
+            return true;
+        }
+        friend class CBTransferAwaiter;
+};
+
+/**
+ * @class CBTransferAwaiter
+ * @brief Awaitable form of one queued transfer, `co_await` yields its `libusb_error`.
+ *
+ * The coroutine suspends without blocking its thread and is resumed on the event thread once the
+ * transfer completes, times out (`LIBUSB_ERROR_TIMEOUT`) or is cancelled (`LIBUSB_ERROR_INTERRUPTED`).
+ * Submission errors (`LIBUSB_ERROR_NOT_FOUND` without `start_async()`, `LIBUSB_ERROR_BUSY` when the
+ * endpoint queue is full) are returned without suspending. Created by `cb_await_read()` / `cb_await_write()`.
+ */
+class CBTransferAwaiter
+{
+    public:
+        using CBSubmit = std::function<libusb_error(CBResult callback, CBTransferTicket *ticket)>;
+        using CBCancel = std::function<void(const CBTransferTicket &ticket)>;
+
+        CBTransferAwaiter(CBSubmit submit, CBCancel cancel, CBCancelToken *token)
+            : submit(std::move(submit)), cancel(std::move(cancel)), token(token) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            std::shared_ptr<CBAwaitState> state = std::make_shared<CBAwaitState>();
+            state->cancel = cancel;
+            if (token && !token->attach(state))
+            {
+                result = LIBUSB_ERROR_INTERRUPTED;
+                return false;
+            }
+            //Held across the submission so neither the completion nor a cancel sees a half filled ticket
+            std::unique_lock<std::mutex> guard(state->lock);
+            if (state->cancelled)
+            {
+                result = LIBUSB_ERROR_INTERRUPTED;
+                return false;
+            }
+            libusb_error err = submit([this, state, handle](libusb_error cb_err) {
+                {
+                    std::lock_guard<std::mutex> done_guard(state->lock);
+                    state->done = true;
+                }
+                result = cb_err;
+                handle.resume();
+            }, &state->ticket);
+            if (err != LIBUSB_SUCCESS)
+            {
+                state->done = true;
+                result = err;
+                return false;
+            }
+            //Once unlocked the coroutine may resume and destroy this awaiter at any time
+            return true;
+        }
+
+        libusb_error await_resume() const noexcept { return result; }
+
+    private:
+        CBSubmit submit;
+        CBCancel cancel;
+        CBCancelToken *token;
+        libusb_error result = LIBUSB_SUCCESS;
+};
+
+/**
+ * @brief Awaitable `read_async()` of a drive, servo or sensor interface.
+ *
+ * @code
+ * CBTask behavior(ChassisBoard &chassis, CBCancelToken &stop) //Any coroutine type
+ * {
+ *     while (co_await cb_await_read(chassis.DrvMtr, 20, &stop) == LIBUSB_SUCCESS)
+ *         ...
+ * }
+ * @endcode
+ *
+ * @param timeout_ms Transfer timeout, the blocking calls use 100 ms.
+ * @param cancel Token able to interrupt the read, optional.
+ *
+ * @note Requires `start_async()`. The coroutine resumes on the event thread: it must not block there,
+ *       and must not be destroyed while it awaits (cancel it and let it resume instead).
+ */
+template <typename Interface>
+inline CBTransferAwaiter cb_await_read(Interface &interface, unsigned int timeout_ms = 100, CBCancelToken *cancel = nullptr)
+{
+    return CBTransferAwaiter(
+        [&interface, timeout_ms](CBResult callback, CBTransferTicket *ticket) { return interface.read_async(callback, timeout_ms, ticket); },
+        [&interface](const CBTransferTicket &ticket) { interface.cancel(ticket); },
+        cancel);
+}
+
+//Awaitable `write_async()` of the current packet of a drive or servo interface, otherwise same as `cb_await_read()`
+template <typename Interface>
+inline CBTransferAwaiter cb_await_write(Interface &interface, unsigned int timeout_ms = 100, CBCancelToken *cancel = nullptr)
+{
+    return CBTransferAwaiter(
+        [&interface, timeout_ms](CBResult callback, CBTransferTicket *ticket) { return interface.write_async(callback, timeout_ms, ticket); },
+        [&interface](const CBTransferTicket &ticket) { interface.cancel(ticket); },
+        cancel);
+}
+
+#endif
+
+#endif
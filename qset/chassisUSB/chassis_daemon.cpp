@@ -0,0 +1,191 @@
+#include "chassis_daemon.h"
+#include "chassis_clock.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ChassisDaemon::ChassisDaemon(ChassisBoard &board) : board(board)
+{
+}
+
+ChassisDaemon::~ChassisDaemon()
+{
+    stop();
+}
+
+bool ChassisDaemon::name_in_use(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    bool alive = false;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(CBShmSegment))
+    {
+        void *map = mmap(nullptr, sizeof(CBShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            const CBShmSegment *other = static_cast<const CBShmSegment*>(map);
+            uint64_t beat = other->heartbeat_ns.load(std::memory_order_relaxed);
+            uint64_t now = cb_now_ns();
+            alive = other->magic.load(std::memory_order_acquire) == cb_shm_magic
+                    && (beat >= now || now - beat < cb_shm_stale_ns);
+            munmap(map, sizeof(CBShmSegment));
+        }
+    }
+    ::close(fd);
+    return alive;
+}
+
+int ChassisDaemon::start(const char *name, double rate_hz)
+{
+    if (segment)
+        return EBUSY;
+
+    //Another daemon still serving the name keeps it
+    if (name_in_use(name))
+        return EEXIST;
+    //A segment left behind by a crashed daemon still has the old queue positions
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0)
+        return errno;
+    if (ftruncate(fd, sizeof(CBShmSegment)) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(name);
+        return err;
+    }
+    void *map = mmap(nullptr, sizeof(CBShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        int err = errno;
+        shm_unlink(name);
+        return err;
+    }
+
+    //The mapping is zero filled, which is the empty state of every status and counter
+    segment = new (map) CBShmSegment;
+    segment->version = cb_shm_version;
+    segment->size = sizeof(CBShmSegment);
+    segment->init_queue();
+    segment->heartbeat_ns.store(cb_now_ns(), std::memory_order_relaxed);
+    segment->magic.store(cb_shm_magic, std::memory_order_release);
+    shm_name = name;
+    board.set_packet_listener(this);
+
+    own_pump = board.start_command_pump(rate_hz) == 0;
+    loop.reset(new ChassisLoopScheduler(rate_hz));
+    int err = loop->start([this](uint64_t) { cycle(); });
+    if (err != 0)
+    {
+        stop();
+        return err;
+    }
+    return 0;
+}
+
+void ChassisDaemon::stop()
+{
+    if (loop)
+        loop->stop();
+    loop.reset();
+    if (own_pump)
+        board.stop_command_pump();
+    own_pump = false;
+    if (!segment)
+        return;
+    board.set_packet_listener(nullptr);
+    //Reads queued by the last cycles may still complete into the listener
+    while (drive_reading || servo_reading || sensor_reading)
+        usleep(1000);
+    CBShmSegment *closing;
+    {
+        std::lock_guard<std::mutex> guard(publish_lock);
+        closing = segment;
+        segment = nullptr;
+    }
+    dropped_at_stop = closing->commands_dropped.load(std::memory_order_relaxed);
+    closing->magic.store(0, std::memory_order_release);
+    munmap(closing, sizeof(CBShmSegment));
+    shm_unlink(shm_name.c_str());
+}
+
+bool ChassisDaemon::is_running()
+{
+    return segment != nullptr && loop && loop->is_running();
+}
+
+CBDaemonStats ChassisDaemon::get_stats()
+{
+    CBDaemonStats stats = {cycles.load(), commands.load(), dropped_at_stop, published.load()};
+    if (segment)
+        stats.commands_dropped = segment->commands_dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ChassisDaemon::cycle()
+{
+    cycles.fetch_add(1, std::memory_order_relaxed);
+    segment->heartbeat_ns.store(cb_now_ns(), std::memory_order_relaxed);
+
+    //Bounded so a flooding client cannot stall the reads, the mailboxes keep only the newest command anyway
+    CBShmCommand command;
+    for (uint32_t i = 0; i < cb_shm_queue_size && segment->pop(command); i++)
+    {
+        if (command.kind == eCBShmDrive)
+            board.DrvMtr.post(command.drive);
+        else if (command.kind == eCBShmServo)
+            board.servos.post(command.servo);
+        commands.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    poll(board.DrvMtr, drive_reading);
+    poll(board.servos, servo_reading);
+    poll(board.sensors, sensor_reading);
+}
+
+template <typename Interface>
+void ChassisDaemon::poll(Interface &interface, std::atomic<bool> &reading)
+{
+    if (reading.exchange(true))
+        return;
+    libusb_error err = interface.read_async([&reading](libusb_error) { reading = false; });
+    if (err == LIBUSB_SUCCESS)
+        return;
+    reading = false;
+    if (err == LIBUSB_ERROR_NOT_FOUND) //No async engine, the listener publishes the blocking read as well
+        interface.read();
+}
+
+void ChassisDaemon::on_packet(const udev_pkt_drvm_sts &packet, uint64_t timestamp_ns)
+{
+    std::lock_guard<std::mutex> guard(publish_lock);
+    if (segment == nullptr)
+        return;
+    segment->drive.publish(packet, timestamp_ns);
+    published.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChassisDaemon::on_packet(const udev_pkt_srvo_sts &packet, uint64_t timestamp_ns)
+{
+    std::lock_guard<std::mutex> guard(publish_lock);
+    if (segment == nullptr)
+        return;
+    segment->servo.publish(packet, timestamp_ns);
+    published.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChassisDaemon::on_packet(const udev_pkt_sens_sts &packet, uint64_t timestamp_ns)
+{
+    std::lock_guard<std::mutex> guard(publish_lock);
+    if (segment == nullptr)
+        return;
+    segment->sensors.publish(packet, timestamp_ns);
+    published.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,105 @@
+#ifndef CHASSIS_DAEMON_H
+#define CHASSIS_DAEMON_H
+
+#include "chassis_board.h"
+#include "chassis_scheduler.h"
+#include "chassis_shm.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @file chassis_daemon.h
+ * @author Kian Cossettini
+ * @brief Shares one chassis board with other local processes through shared memory
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Counters of a running daemon
+struct CBDaemonStats
+{
+    uint64_t cycles;
+    uint64_t commands;         //Commands taken from the queue and posted to the board
+    uint64_t commands_dropped; //Client posts rejected because the queue was full
+    uint64_t published;        //Status packets published to the segment
+};
+
+/**
+ * @class ChassisDaemon
+ * @brief Owns a `ChassisBoard` on behalf of every local process.
+ *
+ * Only one process can claim the board interfaces. The daemon is that process: it publishes every
+ * drive, servo and sensor status packet the board receives into a shared-memory segment (one
+ * sequence lock per interface), and forwards the commands clients queue through `ChassisShmClient`
+ * to the board's command mailboxes, sent by the command pump.
+ *
+ * Each cycle the daemon refreshes its heartbeat, drains the command queue and reads every interface
+ * once. Reads are queued if `start_async()` was called (one per interface in flight), blocking otherwise.
+ * Packets read by anyone else in the daemon process (e.g. a sensor stream) are published as well.
+ *
+ * @code
+ * ChassisBoard chassis;
+ * chassis.initialize(LIBUSB_LOG_LEVEL_NONE);
+ * chassis.claimInterfaces();
+ * chassis.start_async();
+ * ChassisDaemon daemon(chassis);
+ * daemon.start(cb_shm_default_name, 500);
+ * @endcode
+ */
+class ChassisDaemon : private CBPacketListener
+{
+    public:
+        //The board must stay initialized and claimed while the daemon runs
+        explicit ChassisDaemon(ChassisBoard &board);
+        ChassisDaemon(const ChassisDaemon&) = delete;
+        ChassisDaemon& operator=(const ChassisDaemon&) = delete;
+        ~ChassisDaemon();
+
+        /**
+         * @brief Creates the shared-memory segment `name` and starts serving at `rate_hz`.
+         *
+         * Also starts the board's command pump at `rate_hz` unless it is already running.
+         * A stale segment of a previous daemon (heartbeat older than `cb_shm_stale_ns`) is replaced.
+         *
+         * @return 0 on success, `EBUSY` if already running, `EEXIST` if another daemon still serves
+         *         `name`, otherwise an errno value.
+         */
+        int start(const char *name = cb_shm_default_name, double rate_hz = 500);
+        //Stops serving and removes the segment, clients see the heartbeat stop
+        void stop();
+        bool is_running();
+        CBDaemonStats get_stats();
+
+    private:
+        ChassisBoard &board;
+        CBShmSegment *segment = nullptr;
+        std::string shm_name;
+        std::unique_ptr<ChassisLoopScheduler> loop;
+        bool own_pump = false;
+        //Status packets can arrive from several threads, the segment takes one writer per interface
+        std::mutex publish_lock;
+        std::atomic<bool> drive_reading{false};
+        std::atomic<bool> servo_reading{false};
+        std::atomic<bool> sensor_reading{false};
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> commands{0};
+        std::atomic<uint64_t> published{0};
+        uint64_t dropped_at_stop = 0;
+
+        void cycle();
+        //True if `name` holds a segment whose daemon is still beating
+        static bool name_in_use(const char *name);
+        //Queues a read of one interface, falls back to a blocking read without the async engine
+        template <typename Interface>
+        void poll(Interface &interface, std::atomic<bool> &reading);
+        void on_packet(const udev_pkt_drvm_sts &packet, uint64_t timestamp_ns) override;
+        void on_packet(const udev_pkt_srvo_sts &packet, uint64_t timestamp_ns) override;
+        void on_packet(const udev_pkt_sens_sts &packet, uint64_t timestamp_ns) override;
+};
+
+#endif
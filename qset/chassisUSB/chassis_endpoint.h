@@ -0,0 +1,97 @@
+#ifndef CHASSIS_ENDPOINT_H
+#define CHASSIS_ENDPOINT_H
+
+#include "dependencies/usb_packet.h"
+#include <libusb-1.0/libusb.h>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+/**
+ * @file chassis_endpoint.h
+ * @author Kian Cossettini
+ * @brief Compile-time descriptors of the chassis board data interfaces
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @brief Describes one data interface of the board: its packets, endpoints and interface number.
+ *
+ * Everything is checked when the descriptor is instantiated, so a wrong endpoint direction or an
+ * oversized packet is a build error instead of a failed transfer. `ChassisBoard` builds the transfer
+ * paths of every interface from its descriptor (see `ChassisBoard::CBEndpointInterface`).
+ *
+ * @tparam Ctrl Host to board packet from `usb_packet.h`, an empty struct for read-only interfaces.
+ * @tparam Sts Board to host packet from `usb_packet.h`.
+ */
+template <typename Ctrl, typename Sts, uint8_t OutEp, uint8_t InEp, unsigned MaxPacket, uint8_t InterfaceNum>
+struct CBEndpoint
+{
+    using ctrl_packet = Ctrl;
+    using sts_packet = Sts;
+    static constexpr bool writable = !std::is_empty<Ctrl>::value;
+    static constexpr uint8_t out_ep = OutEp;
+    static constexpr uint8_t in_ep = InEp;
+    static constexpr unsigned max_packet = MaxPacket;
+    static constexpr uint8_t interface_num = InterfaceNum;
+
+    static_assert(std::is_trivially_copyable<Ctrl>::value && std::is_trivially_copyable<Sts>::value,
+        "Chassis packets are sent as raw bytes and must be trivially copyable");
+    static_assert((InEp & LIBUSB_ENDPOINT_IN) != 0, "Status endpoint must be an IN endpoint");
+    static_assert(!writable || (OutEp & LIBUSB_ENDPOINT_IN) == 0, "Control endpoint must be an OUT endpoint");
+    static_assert(sizeof(Sts) <= MaxPacket, "Status packet does not fit the endpoint");
+    static_assert(!writable || sizeof(Ctrl) <= MaxPacket, "Control packet does not fit the endpoint");
+};
+
+using CBSensorEndpoint = CBEndpoint<udev_pkt_sens_ctrl, udev_pkt_sens_sts, SENS_RXD_EP, SENS_TXD_EP, SENS_DATA_SZ, SENS_DATA_INUM>;
+using CBServoEndpoint = CBEndpoint<udev_pkt_srvo_ctrl, udev_pkt_srvo_sts, SRVO_RXD_EP, SRVO_TXD_EP, SRVO_DATA_SZ, SRVO_DATA_INUM>;
+using CBDriveMotorEndpoint = CBEndpoint<udev_pkt_drvm_ctrl, udev_pkt_drvm_sts, DRVM_RXD_EP, DRVM_TXD_EP, DRVM_DATA_SZ, DRVM_DATA_INUM>;
+
+//Whether two interfaces would compete for an endpoint or an interface number
+template <typename A, typename B>
+constexpr bool cb_endpoints_overlap()
+{
+    return A::in_ep == B::in_ep || A::interface_num == B::interface_num
+        || (A::writable && B::writable && A::out_ep == B::out_ep);
+}
+
+static_assert(!cb_endpoints_overlap<CBDriveMotorEndpoint, CBServoEndpoint>(), "Drive motor and servo interfaces share an endpoint");
+static_assert(!cb_endpoints_overlap<CBDriveMotorEndpoint, CBSensorEndpoint>(), "Drive motor and sensor interfaces share an endpoint");
+//The current firmware serves sensor reads on the servo interface (`SENS_*` aliases `SRVO_*` in `usb_dev.h`),
+//define `CHASSIS_STRICT_ENDPOINTS` to reject that once the sensors get an interface of their own
+#ifdef CHASSIS_STRICT_ENDPOINTS
+static_assert(!cb_endpoints_overlap<CBServoEndpoint, CBSensorEndpoint>(), "Servo and sensor interfaces share an endpoint");
+#endif
+
+//Wraps a callback based submit function into a future
+inline std::future<libusb_error> submit_as_future(const std::function<libusb_error(std::function<void(libusb_error)>)> &submit)
+{
+    auto promise = std::make_shared<std::promise<libusb_error>>();
+    std::future<libusb_error> result = promise->get_future();
+    libusb_error err = submit([promise](libusb_error cb_err) { promise->set_value(cb_err); });
+    if (err != LIBUSB_SUCCESS)
+        promise->set_value(err);
+    return result;
+}
+
+//Views a received payload as a packet struct, nullptr if the read failed or is too short
+template <typename Packet>
+inline const Packet *packet_view(libusb_error err, const unsigned char *data, int length)
+{
+    return err == LIBUSB_SUCCESS && length >= (int)sizeof(Packet) ? reinterpret_cast<const Packet*>(data) : nullptr;
+}
+
+//Copies a received payload into a packet struct without overrunning it
+template <typename Packet>
+inline void copy_packet(Packet &packet, const unsigned char *data, int length)
+{
+    memcpy(&packet, data, (size_t)length < sizeof(Packet) ? (size_t)length : sizeof(Packet));
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "chassis_filter.h"
+
+bool ChassisAdcFilter::configure(const CBAdcFilterConfig &config)
+{
+    if (config.median < 1 || config.median > max_window || config.median % 2 == 0)
+        return false;
+    if (config.moving_average < 1 || config.moving_average > max_window)
+        return false;
+    if (!(config.iir_alpha > 0.0f && config.iir_alpha <= 1.0f) || config.decimation < 1)
+        return false;
+    std::lock_guard<std::mutex> guard(lock);
+    this->config = config;
+    enabled = true;
+    reset();
+    return true;
+}
+
+CBAdcFilterConfig ChassisAdcFilter::get_config()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return config;
+}
+
+bool ChassisAdcFilter::is_enabled()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return enabled;
+}
+
+void ChassisAdcFilter::reset()
+{
+    median_next = median_filled = 0;
+    mean_sum = lanes{};
+    mean_next = mean_filled = 0;
+    iir_primed = false;
+    decimate_count = 0;
+    has_latest = false;
+}
+
+void ChassisAdcFilter::median_stage(lanes &x)
+{
+    median_hist[median_next] = x;
+    median_next = (median_next + 1) % config.median;
+    if (median_filled < config.median)
+        median_filled++;
+
+    //Odd-even transposition sort, every compare-exchange orders all lanes at once
+    lanes sorted[max_window];
+    for (unsigned i = 0; i < median_filled; i++)
+        sorted[i] = median_hist[i];
+    for (unsigned pass = 0; pass < median_filled; pass++)
+    {
+        for (unsigned i = pass & 1; i + 1 < median_filled; i += 2)
+        {
+            lanes low = sorted[i] < sorted[i + 1] ? sorted[i] : sorted[i + 1];
+            lanes high = sorted[i] < sorted[i + 1] ? sorted[i + 1] : sorted[i];
+            sorted[i] = low;
+            sorted[i + 1] = high;
+        }
+    }
+    x = sorted[median_filled / 2];
+}
+
+void ChassisAdcFilter::mean_stage(lanes &x)
+{
+    if (mean_filled == config.moving_average)
+        mean_sum -= mean_hist[mean_next];
+    else
+        mean_filled++;
+    mean_hist[mean_next] = x;
+    mean_sum += x;
+    mean_next = (mean_next + 1) % config.moving_average;
+    //Rebuilt once per window so float rounding in the running sum cannot accumulate
+    if (mean_next == 0)
+    {
+        mean_sum = lanes{};
+        for (unsigned i = 0; i < mean_filled; i++)
+            mean_sum += mean_hist[i];
+    }
+    x = mean_sum / (float)mean_filled;
+}
+
+void ChassisAdcFilter::iir_stage(lanes &x)
+{
+    if (!iir_primed)
+    {
+        iir_state = x;
+        iir_primed = true;
+    }
+    else
+        iir_state += config.iir_alpha * (x - iir_state);
+    x = iir_state;
+}
+
+bool ChassisAdcFilter::push(const udev_pkt_sens_sts &packet, uint64_t timestamp_ns)
+{
+    lanes x = {};
+    for (int i = 0; i < eN_DrvADC; i++)
+    {
+        x[i] = (float)packet.adc_vals[i];
+        x[eN_DrvADC + i] = packet.adc_volts[i];
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (!enabled)
+        return false;
+    if (config.median > 1)
+        median_stage(x);
+    if (config.moving_average > 1)
+        mean_stage(x);
+    if (config.iir_alpha < 1.0f)
+        iir_stage(x);
+    if (++decimate_count < config.decimation)
+        return false;
+    decimate_count = 0;
+
+    latest.timestamp_ns = timestamp_ns;
+    latest.sequence = has_latest ? latest.sequence + 1 : 1;
+    for (int i = 0; i < eN_DrvADC; i++)
+    {
+        latest.adc_vals[i] = x[i];
+        latest.adc_volts[i] = x[eN_DrvADC + i];
+    }
+    has_latest = true;
+    return true;
+}
+
+bool ChassisAdcFilter::get_latest(CBAdcFilterSample &out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!has_latest)
+        return false;
+    out = latest;
+    return true;
+}
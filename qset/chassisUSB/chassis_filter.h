@@ -0,0 +1,101 @@
+#ifndef CHASSIS_FILTER_H
+#define CHASSIS_FILTER_H
+
+#include "dependencies/usb_packet.h"
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @file chassis_filter.h
+ * @author Kian Cossettini
+ * @brief Filtering and decimation of the chassis ADC samples
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Stages of the ADC filter, applied in the order listed. A stage set to 1 is skipped.
+struct CBAdcFilterConfig
+{
+    unsigned median = 1;         //Median of the last N samples (odd, up to `ChassisAdcFilter::max_window`), removes spikes
+    unsigned moving_average = 1; //Mean of the last N samples (up to `ChassisAdcFilter::max_window`)
+    float iir_alpha = 1.0f;      //First order low-pass y += alpha * (x - y), 0 < alpha <= 1
+    unsigned decimation = 1;     //Publishes every Nth filtered sample
+};
+
+//Filtered ADC sample, published next to the raw `udev_pkt_sens_sts`
+struct CBAdcFilterSample
+{
+    uint64_t timestamp_ns; //Arrival time of the newest sample that went into it
+    uint64_t sequence;     //Number of samples published so far, including this one
+    float adc_vals[eN_DrvADC];
+    float adc_volts[eN_DrvADC];
+};
+
+/**
+ * @class ChassisAdcFilter
+ * @brief Filters every ADC channel of each sensor packet together.
+ *
+ * The raw counts and volts of all `eN_DrvADC` channels (the four ADCs and the temperature) of one
+ * packet are packed into a single vector of float lanes, so every stage handles all channels with
+ * the same few vector operations (SSE/AVX/NEON, whatever the target offers) instead of a loop per channel.
+ *
+ * @note `push()` may be called from several threads, the filter state is guarded by a lock.
+ */
+class ChassisAdcFilter
+{
+    public:
+        //Longest median / moving average window
+        static constexpr unsigned max_window = 16;
+
+        /**
+         * @brief Replaces the configuration and clears the filter history.
+         *
+         * @return false (and keeps the old configuration) if a stage is out of range.
+         */
+        bool configure(const CBAdcFilterConfig &config);
+        CBAdcFilterConfig get_config();
+        //Whether `configure()` has been called, nothing is published before
+        bool is_enabled();
+
+        /**
+         * @brief Feeds one received packet through the pipeline.
+         *
+         * @return true if a new filtered sample was published (every `decimation` packets).
+         */
+        bool push(const udev_pkt_sens_sts &packet, uint64_t timestamp_ns);
+
+        //Copies the latest published sample, false if nothing has been published yet
+        bool get_latest(CBAdcFilterSample &out);
+
+    private:
+        //Counts in lanes [0, eN_DrvADC), volts in lanes [eN_DrvADC, 2 * eN_DrvADC)
+        typedef float lanes __attribute__((vector_size(64)));
+        static_assert(2 * eN_DrvADC <= 16, "ADC channels do not fit the filter lanes");
+
+        std::mutex lock;
+        bool enabled = false;
+        CBAdcFilterConfig config;
+        lanes median_hist[max_window];
+        unsigned median_next = 0;
+        unsigned median_filled = 0;
+        lanes mean_hist[max_window];
+        lanes mean_sum;
+        unsigned mean_next = 0;
+        unsigned mean_filled = 0;
+        lanes iir_state;
+        bool iir_primed = false;
+        unsigned decimate_count = 0;
+        CBAdcFilterSample latest;
+        bool has_latest = false;
+
+        void reset();
+        //Stages filter `x` in place (64 byte vectors are not passed by value, that would depend on AVX-512)
+        void median_stage(lanes &x);
+        void mean_stage(lanes &x);
+        void iir_stage(lanes &x);
+};
+
+#endif
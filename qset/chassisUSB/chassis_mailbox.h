@@ -0,0 +1,112 @@
+#ifndef CHASSIS_MAILBOX_H
+#define CHASSIS_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @file chassis_mailbox.h
+ * @author Kian Cossettini
+ * @brief Last-writer-wins mailbox for setpoints posted by several threads
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @class ChassisMailbox
+ * @brief Lock-free mailbox holding only the newest value, any number of producers, one consumer.
+ *
+ * Every `post()` draws a ticket and writes into one of `Slots` buffers, each guarded by a sequence
+ * number. The consumer reads the buffer of the newest ticket and retries if a writer replaced it
+ * meanwhile. A producer only waits if the producer `Slots` tickets before it is still copying into
+ * the same buffer. A value older than the one already in its buffer is dropped, since a newer one
+ * has been posted anyway.
+ *
+ * @tparam T Trivially copyable value type (e.g. a control packet from `usb_packet.h`).
+ * @tparam Slots Number of buffers, must be a power of two.
+ */
+template <typename T, unsigned Slots = 8>
+class ChassisMailbox
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ChassisMailbox values must be trivially copyable");
+    static_assert(Slots >= 2 && (Slots & (Slots - 1)) == 0, "ChassisMailbox slot count must be a power of two");
+
+    private:
+        struct alignas(64) Slot
+        {
+            //2 * ticket + 1 while ticket is being written, 2 * ticket + 2 once it is complete
+            std::atomic<uint64_t> seq{0};
+            T value;
+        };
+        alignas(64) std::atomic<uint64_t> next_ticket{0};
+        alignas(64) std::atomic<uint64_t> latest{0}; //Newest complete ticket + 1, 0 = empty
+        alignas(64) uint64_t taken = 0;              //Consumer only, `latest` at the last take()
+        Slot slots[Slots];
+
+    public:
+        //Any thread. Publishes `value` as the newest value.
+        void post(const T &value)
+        {
+            uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+            Slot &slot = slots[ticket & (Slots - 1)];
+            uint64_t writing = 2 * ticket + 1;
+            uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if (seq >= writing)
+                    return; //A newer post already owns this buffer
+                if ((seq & 1) == 0 && slot.seq.compare_exchange_weak(seq, writing, std::memory_order_acquire, std::memory_order_relaxed))
+                    break;
+                if (seq & 1)
+                    seq = slot.seq.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&slot.value, &value, sizeof(T));
+            slot.seq.store(writing + 1, std::memory_order_release);
+
+            uint64_t published = latest.load(std::memory_order_relaxed);
+            while (published < ticket + 1 && !latest.compare_exchange_weak(published, ticket + 1, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+
+        /**
+         * @brief Consumer only. Copies the newest value if one was posted since the last call.
+         *
+         * @param skipped If not null, set to the number of posts overwritten since the last take.
+         * @return true if `out` was updated.
+         */
+        bool take(T &out, uint64_t *skipped = nullptr)
+        {
+            while (true)
+            {
+                uint64_t newest = latest.load(std::memory_order_acquire);
+                if (newest == taken)
+                    return false;
+                uint64_t ticket = newest - 1;
+                Slot &slot = slots[ticket & (Slots - 1)];
+                if (slot.seq.load(std::memory_order_acquire) != 2 * ticket + 2)
+                    continue; //Replaced by a newer post, `latest` follows shortly
+                memcpy(&out, &slot.value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != 2 * ticket + 2)
+                    continue;
+                if (skipped)
+                    *skipped = newest - taken - 1;
+                taken = newest;
+                return true;
+            }
+        }
+
+        //Total number of posts so far
+        uint64_t get_posted() const
+        {
+            return next_ticket.load(std::memory_order_relaxed);
+        }
+};
+
+#endif
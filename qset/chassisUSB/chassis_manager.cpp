@@ -0,0 +1,217 @@
+#include "chassis_manager.h"
+
+ChassisBoardManager::~ChassisBoardManager()
+{
+    {
+        //Boards first, they deregister from the context and still need the event thread to drain
+        std::lock_guard<std::mutex> guard(lock);
+        while (!boards.empty())
+        {
+            boards.back().board.reset();
+            boards.back().transport.reset();
+            boards.pop_back();
+        }
+    }
+    if (running.exchange(false))
+    {
+        libusb_interrupt_event_handler(ctx);
+        event_thread.join();
+    }
+    if (ctx)
+        libusb_exit(ctx);
+}
+
+libusb_error ChassisBoardManager::initialize(libusb_log_level log_lvl)
+{
+    if (ctx)
+        return LIBUSB_ERROR_BUSY;
+    int err = libusb_init(&ctx);
+    if (err < LIBUSB_SUCCESS)
+    {
+        ctx = nullptr;
+        return (libusb_error)err;
+    }
+    err = libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, log_lvl);
+    if (err < LIBUSB_SUCCESS)
+    {
+        libusb_exit(ctx);
+        ctx = nullptr;
+        return (libusb_error)err;
+    }
+    this->log_lvl = log_lvl;
+    running = true;
+    event_thread = std::thread(&ChassisBoardManager::event_loop, this);
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisBoardManager::event_loop()
+{
+    timeval timeout = {0, 100000}; //Wakes up to notice the manager stopping
+    while (running)
+    {
+        libusb_handle_events_timeout_completed(ctx, &timeout, nullptr);
+        posted.run();
+    }
+}
+
+CBBoardInfo ChassisBoardManager::describe(libusb_device *device, libusb_device_handle *handle)
+{
+    CBBoardInfo info;
+    info.path = ChassisLibusbTransport::bus_path(device);
+    info.bus = libusb_get_bus_number(device);
+    info.address = libusb_get_device_address(device);
+    if (handle)
+        info.serial = ChassisLibusbTransport::read_serial(handle);
+    return info;
+}
+
+libusb_error ChassisBoardManager::enumerate(std::vector<CBBoardInfo> &found)
+{
+    found.clear();
+    if (ctx == nullptr)
+        return LIBUSB_ERROR_NOT_FOUND;
+
+    libusb_device **devices;
+    ssize_t count = libusb_get_device_list(ctx, &devices);
+    if (count < LIBUSB_SUCCESS)
+        return (libusb_error)count;
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (ssize_t i = 0; i < count; i++)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devices[i], &desc) != LIBUSB_SUCCESS)
+            continue;
+        if (desc.idVendor != ChassisLibusbTransport::B_VID || desc.idProduct != ChassisLibusbTransport::B_PID)
+            continue;
+
+        //Open boards already know their serial, no need to open them a second time
+        std::string path = ChassisLibusbTransport::bus_path(devices[i]);
+        bool listed = false;
+        for (CBManagedBoard &entry : boards)
+        {
+            if (entry.info.path == path)
+            {
+                found.push_back(entry.info);
+                listed = true;
+                break;
+            }
+        }
+        if (listed)
+            continue;
+
+        libusb_device_handle *handle = nullptr;
+        if (libusb_open(devices[i], &handle) != LIBUSB_SUCCESS)
+            handle = nullptr;
+        found.push_back(describe(devices[i], handle));
+        if (handle)
+            libusb_close(handle);
+    }
+    libusb_free_device_list(devices, 1);
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisBoardManager::open(const std::string &id, ChassisBoard **board)
+{
+    *board = nullptr;
+    if (ctx == nullptr)
+        return LIBUSB_ERROR_NOT_FOUND;
+
+    std::vector<CBBoardInfo> found;
+    libusb_error err = enumerate(found);
+    if (err != LIBUSB_SUCCESS)
+        return err;
+
+    std::lock_guard<std::mutex> guard(lock);
+    const CBBoardInfo *match = nullptr;
+    for (const CBBoardInfo &info : found)
+    {
+        bool open_already = false;
+        for (CBManagedBoard &entry : boards)
+            open_already |= entry.info.path == info.path;
+        if (id.empty())
+        {
+            if (!open_already)
+            {
+                match = &info;
+                break;
+            }
+            continue;
+        }
+        if (info.serial == id || info.path == id)
+        {
+            if (open_already)
+                return LIBUSB_ERROR_BUSY;
+            match = &info;
+            break;
+        }
+    }
+    if (match == nullptr)
+        return LIBUSB_ERROR_NOT_FOUND;
+
+    //Find the device again, the list from enumerate() is already freed
+    libusb_device **devices;
+    ssize_t count = libusb_get_device_list(ctx, &devices);
+    if (count < LIBUSB_SUCCESS)
+        return (libusb_error)count;
+    libusb_device *device = nullptr;
+    for (ssize_t i = 0; i < count && device == nullptr; i++)
+        if (libusb_get_bus_number(devices[i]) == match->bus && libusb_get_device_address(devices[i]) == match->address)
+            device = devices[i];
+
+    CBManagedBoard entry;
+    entry.info = *match;
+    if (device)
+        entry.transport.reset(new ChassisLibusbTransport(ctx, device, match->serial, &posted));
+    libusb_free_device_list(devices, 1); //The transport holds its own reference
+    if (device == nullptr)
+        return LIBUSB_ERROR_NO_DEVICE;
+
+    entry.board.reset(new ChassisBoard(*entry.transport));
+    err = entry.board->initialize(log_lvl);
+    if (err == LIBUSB_SUCCESS)
+        err = entry.board->claimInterfaces();
+    if (err != LIBUSB_SUCCESS)
+    {
+        entry.board.reset();
+        return err;
+    }
+    *board = entry.board.get();
+    boards.push_back(std::move(entry));
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisBoardManager::close(ChassisBoard *board)
+{
+    CBManagedBoard entry;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < boards.size(); i++)
+        {
+            if (boards[i].board.get() == board)
+            {
+                entry = std::move(boards[i]);
+                boards.erase(boards.begin() + i);
+                break;
+            }
+        }
+    }
+    //Outside the lock, stopping waits on transfers completed by the event thread
+    entry.board.reset();
+    entry.transport.reset();
+}
+
+CBBoardInfo ChassisBoardManager::get_info(const ChassisBoard *board)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (CBManagedBoard &entry : boards)
+        if (entry.board.get() == board)
+            return entry.info;
+    return CBBoardInfo();
+}
+
+size_t ChassisBoardManager::get_open_count()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return boards.size();
+}
@@ -0,0 +1,120 @@
+#ifndef CHASSIS_MANAGER_H
+#define CHASSIS_MANAGER_H
+
+#include "chassis_board.h"
+#include "chassis_transport_libusb.h"
+#include <libusb-1.0/libusb.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file chassis_manager.h
+ * @author Kian Cossettini
+ * @brief QSET Multi Chassis Board Manager
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Chassis board found by `ChassisBoardManager::enumerate()`
+struct CBBoardInfo
+{
+    std::string serial; //USB serial number, empty if the board has none or could not be opened
+    std::string path;   //Physical location "bus-port.port...", e.g. "1-2.3"
+    uint8_t bus = 0;
+    uint8_t address = 0;
+};
+
+/**
+ * @class ChassisBoardManager
+ * @brief Runs every attached chassis board on one libusb context and one event thread.
+ *
+ * `enumerate()` lists all boards matching the chassis VID/PID. `open()` picks one by serial number
+ * or bus path and returns a regular `ChassisBoard` with its interfaces already claimed. All boards
+ * share the manager's context: their asynchronous transfers, notifications and hotplug events are
+ * serviced by the single manager thread instead of one event thread per board.
+ *
+ * @code
+ * ChassisBoardManager manager;
+ * manager.initialize(LIBUSB_LOG_LEVEL_NONE);
+ * ChassisBoard *front, *rear;
+ * manager.open("CB-0001", &front);
+ * manager.open("CB-0002", &rear);
+ * front->start_async();
+ * rear->start_async();
+ * @endcode
+ *
+ * @note Boards are owned by the manager and stay valid until `close()` or the manager's destruction.
+ */
+class ChassisBoardManager
+{
+    public:
+        ChassisBoardManager() = default;
+        ChassisBoardManager(const ChassisBoardManager&) = delete;
+        ChassisBoardManager& operator=(const ChassisBoardManager&) = delete;
+        //Closes every board, then stops the event thread and releases the context
+        ~ChassisBoardManager();
+
+        /**
+         * @brief Initializes the shared libusb context and starts the event thread.
+         *
+         * @return `LIBUSB_SUCCESS`, `LIBUSB_ERROR_BUSY` if already initialized, otherwise a libusb error code.
+         */
+        libusb_error initialize(libusb_log_level log_lvl);
+
+        /**
+         * @brief Lists every attached chassis board.
+         *
+         * Reading the serial number briefly opens boards that are not open yet.
+         *
+         * @return `LIBUSB_SUCCESS`, otherwise a libusb error code (`found` is then empty).
+         */
+        libusb_error enumerate(std::vector<CBBoardInfo> &found);
+
+        /**
+         * @brief Opens a board and claims its interfaces.
+         *
+         * @param id Serial number or bus path of the board, empty for the first board not open yet.
+         * @param board Receives the board, owned by the manager.
+         *
+         * @return `LIBUSB_SUCCESS`, `LIBUSB_ERROR_NOT_FOUND` if no board matches, `LIBUSB_ERROR_BUSY`
+         *         if the board is already open, otherwise the error of `initialize()`/`claimInterfaces()`.
+         */
+        libusb_error open(const std::string &id, ChassisBoard **board);
+
+        //Stops and releases a board returned by `open()`
+        void close(ChassisBoard *board);
+
+        //Identity of an open board
+        CBBoardInfo get_info(const ChassisBoard *board);
+
+        size_t get_open_count();
+
+    private:
+        struct CBManagedBoard
+        {
+            CBBoardInfo info;
+            std::unique_ptr<ChassisLibusbTransport> transport;
+            std::unique_ptr<ChassisBoard> board;
+        };
+
+        libusb_context *ctx = nullptr;
+        libusb_log_level log_lvl = LIBUSB_LOG_LEVEL_NONE;
+        std::mutex lock;
+        std::vector<CBManagedBoard> boards;
+        //Failures the boards' engines complete on the event thread
+        CBPostedCompletions posted;
+        std::atomic<bool> running{false};
+        std::thread event_thread;
+
+        void event_loop();
+        static CBBoardInfo describe(libusb_device *device, libusb_device_handle *handle);
+};
+
+#endif
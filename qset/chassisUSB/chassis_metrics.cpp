@@ -0,0 +1,221 @@
+#include "chassis_metrics.h"
+#include "chassis_clock.h"
+#include <libusb-1.0/libusb.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+//libusb error code of an `errors_by_code` index
+static int error_code_of(int index)
+{
+    return index == cb_metrics_error_codes - 1 ? LIBUSB_ERROR_OTHER : -index;
+}
+
+ChassisMetrics::~ChassisMetrics()
+{
+    stop_export();
+}
+
+std::vector<CBEndpointMetrics> ChassisMetrics::snapshot()
+{
+    return snapshot(api_rate);
+}
+
+std::vector<CBEndpointMetrics> ChassisMetrics::snapshot(CBRateWindow &window)
+{
+    std::vector<CBEndpointMetrics> result;
+    std::lock_guard<std::mutex> guard(rate_lock);
+    uint64_t now = cb_now_ns();
+    double elapsed = window.ns ? (now - window.ns) / 1e9 : 0.0;
+    window.ns = now;
+    for (int i = 0; i < n_slots; i++)
+    {
+        CBEndpointSlot &slot = slots[i];
+        uint64_t transfers = slot.transfers.load(std::memory_order_relaxed);
+        if (transfers == 0)
+            continue;
+        CBEndpointMetrics metrics = {};
+        metrics.endpoint = (i & 0x0F) | (i >= 16 ? 0x80 : 0x00);
+        metrics.transfers = transfers;
+        metrics.bytes = slot.bytes.load(std::memory_order_relaxed);
+        metrics.latency_sum_ns = slot.latency_sum_ns.load(std::memory_order_relaxed);
+        for (int code = 0; code < cb_metrics_error_codes; code++)
+        {
+            metrics.errors_by_code[code] = slot.errors_by_code[code].load(std::memory_order_relaxed);
+            metrics.errors += metrics.errors_by_code[code];
+        }
+        metrics.timeouts = metrics.errors_by_code[-LIBUSB_ERROR_TIMEOUT];
+        for (int bucket = 0; bucket < cb_metrics_latency_buckets; bucket++)
+            metrics.latency_buckets[bucket] = slot.latency_buckets[bucket].load(std::memory_order_relaxed);
+        if (elapsed > 0 && metrics.bytes >= window.bytes[i])
+            metrics.bytes_per_sec = (metrics.bytes - window.bytes[i]) / elapsed;
+        window.bytes[i] = metrics.bytes;
+        result.push_back(metrics);
+    }
+    return result;
+}
+
+void ChassisMetrics::reset()
+{
+    for (CBEndpointSlot &slot : slots)
+    {
+        slot.transfers = 0;
+        slot.bytes = 0;
+        slot.latency_sum_ns = 0;
+        for (auto &count : slot.errors_by_code)
+            count = 0;
+        for (auto &count : slot.latency_buckets)
+            count = 0;
+    }
+    std::lock_guard<std::mutex> guard(rate_lock);
+    api_rate = CBRateWindow();
+    export_rate = CBRateWindow();
+}
+
+void ChassisMetrics::format_prometheus(std::string &out, const std::string &labels)
+{
+    std::vector<CBEndpointMetrics> endpoints = snapshot(export_rate);
+    char line[256];
+    //Label set of an endpoint, with the extra labels and an optional last label
+    auto label_set = [&labels](uint8_t endpoint, const char *extra) {
+        char ep[8];
+        snprintf(ep, sizeof(ep), "0x%02X", endpoint);
+        std::string set = "{endpoint=\"" + std::string(ep) + "\"";
+        if (!labels.empty())
+            set += "," + labels;
+        if (extra)
+            set += std::string(",") + extra;
+        return set + "}";
+    };
+    auto header = [&out](const char *name, const char *type, const char *help) {
+        out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+    };
+
+    header("chassis_usb_transfers_total", "counter", "Completed transfers.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        snprintf(line, sizeof(line), " %llu\n", (unsigned long long)m.transfers);
+        out += "chassis_usb_transfers_total" + label_set(m.endpoint, nullptr) + line;
+    }
+    header("chassis_usb_timeouts_total", "counter", "Transfers that timed out.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        snprintf(line, sizeof(line), " %llu\n", (unsigned long long)m.timeouts);
+        out += "chassis_usb_timeouts_total" + label_set(m.endpoint, nullptr) + line;
+    }
+    header("chassis_usb_errors_total", "counter", "Failed transfers by libusb error.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        for (int code = 1; code < cb_metrics_error_codes; code++)
+        {
+            if (m.errors_by_code[code] == 0)
+                continue;
+            std::string error = std::string("error=\"") + libusb_error_name(error_code_of(code)) + "\"";
+            snprintf(line, sizeof(line), " %llu\n", (unsigned long long)m.errors_by_code[code]);
+            out += "chassis_usb_errors_total" + label_set(m.endpoint, error.c_str()) + line;
+        }
+    }
+    header("chassis_usb_bytes_total", "counter", "Payload bytes transferred.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        snprintf(line, sizeof(line), " %llu\n", (unsigned long long)m.bytes);
+        out += "chassis_usb_bytes_total" + label_set(m.endpoint, nullptr) + line;
+    }
+    header("chassis_usb_bytes_per_second", "gauge", "Payload throughput since the previous export.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        snprintf(line, sizeof(line), " %.1f\n", m.bytes_per_sec);
+        out += "chassis_usb_bytes_per_second" + label_set(m.endpoint, nullptr) + line;
+    }
+    header("chassis_usb_transfer_latency_seconds", "histogram", "Time from submission to completion.");
+    for (const CBEndpointMetrics &m : endpoints)
+    {
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < cb_metrics_latency_buckets; bucket++)
+        {
+            cumulative += m.latency_buckets[bucket];
+            char le[32];
+            if (bucket == cb_metrics_latency_buckets - 1)
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            else
+                snprintf(le, sizeof(le), "le=\"%g\"", (double)((uint64_t)1 << bucket) * 1e-6);
+            snprintf(line, sizeof(line), " %llu\n", (unsigned long long)cumulative);
+            out += "chassis_usb_transfer_latency_seconds_bucket" + label_set(m.endpoint, le) + line;
+        }
+        snprintf(line, sizeof(line), " %.9f\n", m.latency_sum_ns / 1e9);
+        out += "chassis_usb_transfer_latency_seconds_sum" + label_set(m.endpoint, nullptr) + line;
+        snprintf(line, sizeof(line), " %llu\n", (unsigned long long)m.transfers);
+        out += "chassis_usb_transfer_latency_seconds_count" + label_set(m.endpoint, nullptr) + line;
+    }
+}
+
+int ChassisMetrics::write_prometheus(const char *path, const std::string &labels)
+{
+    std::string text;
+    format_prometheus(text, labels);
+
+    std::string tmp_path = std::string(path) + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return errno;
+    size_t done = 0;
+    while (done < text.size())
+    {
+        ssize_t written = ::write(fd, text.data() + done, text.size() - done);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            int err = errno;
+            ::close(fd);
+            ::unlink(tmp_path.c_str());
+            return err;
+        }
+        done += written;
+    }
+    ::close(fd);
+    if (::rename(tmp_path.c_str(), path) != 0)
+    {
+        int err = errno;
+        ::unlink(tmp_path.c_str());
+        return err;
+    }
+    return 0;
+}
+
+int ChassisMetrics::start_export(const char *path, unsigned interval_ms, const std::string &labels)
+{
+    if (interval_ms == 0)
+        return EINVAL;
+    std::lock_guard<std::mutex> guard(export_lock);
+    if (export_thread.joinable())
+        return EBUSY;
+    export_stopping = false;
+    std::string file = path;
+    export_thread = std::thread([this, file, interval_ms, labels]() {
+        std::unique_lock<std::mutex> lock(export_lock);
+        while (!export_stopping)
+        {
+            lock.unlock();
+            write_prometheus(file.c_str(), labels); //A failed write is retried next interval
+            lock.lock();
+            export_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return export_stopping; });
+        }
+    });
+    return 0;
+}
+
+void ChassisMetrics::stop_export()
+{
+    std::thread stopping;
+    {
+        std::lock_guard<std::mutex> guard(export_lock);
+        export_stopping = true;
+        stopping = std::move(export_thread);
+    }
+    export_cv.notify_all();
+    if (stopping.joinable())
+        stopping.join();
+}
@@ -0,0 +1,139 @@
+#ifndef CHASSIS_METRICS_H
+#define CHASSIS_METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file chassis_metrics.h
+ * @author Kian Cossettini
+ * @brief Per-endpoint transfer metrics and Prometheus export
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Error buckets: index -err for LIBUSB_ERROR_IO (1) to LIBUSB_ERROR_NOT_SUPPORTED (12), 13 for LIBUSB_ERROR_OTHER
+static constexpr int cb_metrics_error_codes = 14;
+//Latency buckets: bucket i counts transfers that took less than 2^i us, the last one everything slower
+static constexpr int cb_metrics_latency_buckets = 22;
+
+//Metrics of one endpoint, see `ChassisMetrics::snapshot()`
+struct CBEndpointMetrics
+{
+    uint8_t endpoint;
+    uint64_t transfers;
+    uint64_t timeouts;
+    uint64_t errors;   //Failed transfers, timeouts included
+    uint64_t bytes;
+    uint64_t errors_by_code[cb_metrics_error_codes];
+    uint64_t latency_buckets[cb_metrics_latency_buckets];
+    uint64_t latency_sum_ns;
+    double bytes_per_sec; //Since the previous snapshot
+};
+
+/**
+ * @class ChassisMetrics
+ * @brief Counts transfers, errors, bytes and latency per endpoint.
+ *
+ * `record()` sits on the transfer hot path: it only does a handful of relaxed atomic increments on
+ * counters owned by the endpoint (one cache line group per endpoint, no locks, no allocation).
+ * `snapshot()` reads them for the API, `write_prometheus()` writes them in the Prometheus text
+ * format, and `start_export()` rewrites such a file periodically for the node exporter textfile collector.
+ */
+class ChassisMetrics
+{
+    public:
+        ChassisMetrics() = default;
+        ChassisMetrics(const ChassisMetrics&) = delete;
+        ChassisMetrics& operator=(const ChassisMetrics&) = delete;
+        ~ChassisMetrics();
+
+        //Any thread. Accounts one completed transfer.
+        void record(uint8_t endpoint, int err, int length, uint64_t latency_ns)
+        {
+            CBEndpointSlot &slot = slots[slot_index(endpoint)];
+            slot.transfers.fetch_add(1, std::memory_order_relaxed);
+            if (length > 0)
+                slot.bytes.fetch_add(length, std::memory_order_relaxed);
+            if (err < 0)
+                slot.errors_by_code[err <= -cb_metrics_error_codes ? cb_metrics_error_codes - 1 : -err].fetch_add(1, std::memory_order_relaxed);
+            slot.latency_buckets[latency_bucket(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+            slot.latency_sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+        }
+
+        //Metrics of every endpoint that saw a transfer, ordered by endpoint address
+        std::vector<CBEndpointMetrics> snapshot();
+        //Clears every counter
+        void reset();
+
+        /**
+         * @brief Writes the metrics to `path` in the Prometheus text format.
+         *
+         * The file is written next to `path` and renamed over it, so readers never see half a file.
+         *
+         * @param labels Extra labels added to every sample, e.g. `board="front"` (may be empty).
+         * @return 0 on success, otherwise an errno value.
+         */
+        int write_prometheus(const char *path, const std::string &labels = std::string());
+        //Appends the metrics in the Prometheus text format to `out`, rates since the previous Prometheus output
+        void format_prometheus(std::string &out, const std::string &labels = std::string());
+
+        /**
+         * @brief Rewrites `path` every `interval_ms` in a background thread.
+         *
+         * @return 0 on success, `EBUSY` if already exporting, `EINVAL` for a zero interval.
+         */
+        int start_export(const char *path, unsigned interval_ms, const std::string &labels = std::string());
+        void stop_export();
+
+    private:
+        static constexpr int n_slots = 32; //16 OUT + 16 IN endpoint addresses
+        struct alignas(64) CBEndpointSlot
+        {
+            std::atomic<uint64_t> transfers{0};
+            std::atomic<uint64_t> bytes{0};
+            std::atomic<uint64_t> latency_sum_ns{0};
+            std::atomic<uint64_t> errors_by_code[cb_metrics_error_codes] = {};
+            std::atomic<uint64_t> latency_buckets[cb_metrics_latency_buckets] = {};
+        };
+        CBEndpointSlot slots[n_slots];
+
+        //Previous byte counts for the bytes/sec rate, one window per reader so `snapshot()` and the
+        //Prometheus export don't shorten each other's interval
+        struct CBRateWindow
+        {
+            uint64_t bytes[n_slots] = {};
+            uint64_t ns = 0;
+        };
+        std::mutex rate_lock;
+        CBRateWindow api_rate;
+        CBRateWindow export_rate;
+
+        std::mutex export_lock;
+        std::condition_variable export_cv;
+        bool export_stopping = false;
+        std::thread export_thread;
+
+        std::vector<CBEndpointMetrics> snapshot(CBRateWindow &window);
+
+        static int slot_index(uint8_t endpoint)
+        {
+            return (endpoint & 0x0F) | ((endpoint & 0x80) ? 16 : 0);
+        }
+        static int latency_bucket(uint64_t latency_ns)
+        {
+            uint64_t us = latency_ns / 1000;
+            int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+            return bucket < cb_metrics_latency_buckets ? bucket : cb_metrics_latency_buckets - 1;
+        }
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include "chassis_mock_board.h"
+#include "chassis_clock.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+//Time constant of the simulated motor velocity loop
+static constexpr float motor_tau_s = 0.05f;
+
+ChassisMockBoard::ChassisMockBoard(const CBMockConfig &config) : config(config), rng(config.seed)
+{
+}
+
+void ChassisMockBoard::set_config(const CBMockConfig &config)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    this->config = config;
+    rng.seed(config.seed);
+}
+
+CBMockConfig ChassisMockBoard::get_config()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return config;
+}
+
+bool ChassisMockBoard::is_notify(uint8_t endpoint)
+{
+    return endpoint == DRVM_NTF_EP || endpoint == SRVO_NTF_EP;
+}
+
+void ChassisMockBoard::inject_status(uint8_t endpoint, udev_status status)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (endpoint == DRVM_NTF_EP)
+        drive_status = status;
+    else
+        servo_status = status;
+    status_generation++;
+
+    uint64_t now = cb_now_ns();
+    for (auto &entry : pending)
+    {
+        if (entry.due_ns != 0 || entry.request->endpoint != endpoint)
+            continue;
+        entry.err = LIBUSB_SUCCESS;
+        pending.schedule(entry, schedule(now, 0, entry.err));
+    }
+    cv.notify_all();
+}
+
+udev_pkt_drvm_ctrl ChassisMockBoard::get_drive_command(eDrvMotors motor)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return motor < eN_DrvMotor ? motors[motor].command : udev_pkt_drvm_ctrl{};
+}
+
+udev_pkt_srvo_ctrl ChassisMockBoard::get_servo_command(eChassisServo servo)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return servo < eN_Servo ? servos[servo] : udev_pkt_srvo_ctrl{};
+}
+
+uint64_t ChassisMockBoard::get_transfer_count()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return transfers;
+}
+
+void ChassisMockBoard::set_connected(bool connected, uint32_t enumerate_us)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (this->connected == connected)
+            return;
+        if (!connected)
+        {
+            this->connected = false;
+            lost_ns = cb_now_ns();
+            link_stats.connected = false;
+            link_stats.disconnects++;
+            for (auto &entry : pending)
+                pending.complete_now(entry, LIBUSB_ERROR_NO_DEVICE);
+            cv.notify_all();
+        }
+    }
+    if (connected && enumerate_us)
+        std::this_thread::sleep_for(std::chrono::microseconds(enumerate_us));
+    if (connected)
+    {
+        //Like a real reconnect, the board is only reported back once the failed transfers completed
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait_for(guard, std::chrono::seconds(1), [this]() {
+            return completing == 0 && std::none_of(pending.begin(), pending.end(), [](const ChassisPendingQueue<>::Entry &entry) { return entry.err == LIBUSB_ERROR_NO_DEVICE; });
+        });
+        uint64_t now = cb_now_ns();
+        this->connected = true;
+        link_stats.connected = true;
+        link_stats.reconnects++;
+        link_stats.last_outage_ns = now - lost_ns;
+        link_stats.max_outage_ns = std::max(link_stats.max_outage_ns, link_stats.last_outage_ns);
+        link_stats.last_reconnect_ns = enumerate_us * 1000ull;
+    }
+    std::lock_guard<std::mutex> handler_guard(handler_lock);
+    if (link_handler)
+        link_handler(connected);
+}
+
+void ChassisMockBoard::set_link_handler(CBLinkHandler handler)
+{
+    std::lock_guard<std::mutex> guard(handler_lock);
+    link_handler = std::move(handler);
+}
+
+CBLinkStats ChassisMockBoard::get_link_stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return link_stats;
+}
+
+libusb_error ChassisMockBoard::open(libusb_log_level)
+{
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisMockBoard::claim_interfaces()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    claimed = true;
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisMockBoard::claim_interface(int interface_num)
+{
+    return interface_num < UDEV_INTERFACES ? LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+}
+
+void ChassisMockBoard::release_interface(int)
+{
+}
+
+uint64_t ChassisMockBoard::schedule(uint64_t now, unsigned int timeout, libusb_error &err)
+{
+    std::uniform_real_distribution<double> roll(0.0, 1.0);
+    uint64_t start = now > bus_free_ns ? now : bus_free_ns;
+    bus_free_ns = start + config.bus_us * 1000ull;
+    uint64_t jitter = config.jitter_us ? std::uniform_int_distribution<uint32_t>(0, config.jitter_us)(rng) : 0;
+    uint64_t due = start + (config.latency_us + jitter) * 1000ull;
+
+    if (config.timeout_rate > 0 && roll(rng) < config.timeout_rate)
+    {
+        err = LIBUSB_ERROR_TIMEOUT;
+        return timeout ? now + timeout * 1000000ull : UINT64_MAX;
+    }
+    if (config.error_rate > 0 && roll(rng) < config.error_rate)
+        err = config.error;
+    if (timeout && due > now + timeout * 1000000ull)
+    {
+        err = LIBUSB_ERROR_TIMEOUT;
+        due = now + timeout * 1000000ull;
+    }
+    return due;
+}
+
+void ChassisMockBoard::step_model(uint64_t now)
+{
+    if (model_time_ns == 0)
+        model_time_ns = now;
+    float dt = (now - model_time_ns) * 1e-9f;
+    model_time_ns = now;
+    if (dt <= 0)
+        return;
+    float alpha = 1.0f - std::exp(-dt / motor_tau_s);
+    for (CBMockMotor &motor : motors)
+    {
+        float target = motor.command.mtr_ctrl.enable ? motor.command.mtr_ctrl.velocity : 0.0f;
+        motor.velocity += alpha * (target - motor.velocity);
+        motor.position += motor.velocity * dt;
+    }
+}
+
+int ChassisMockBoard::respond(uint8_t endpoint, unsigned char *data, int length, uint64_t now)
+{
+    transfers++;
+    step_model(now);
+    switch (endpoint)
+    {
+        case DRVM_RXD_EP:
+        {
+            udev_pkt_drvm_ctrl command;
+            if (length < (int)sizeof(command))
+                return length;
+            memcpy(&command, data, sizeof(command));
+            if (command.mtr_id < eN_DrvMotor)
+                motors[command.mtr_id].command = command;
+            return length;
+        }
+        case SRVO_RXD_EP:
+        {
+            udev_pkt_srvo_ctrl command;
+            if (length < (int)sizeof(command))
+                return length;
+            memcpy(&command, data, sizeof(command));
+            if (command.srvo_id < eN_Servo)
+            {
+                servos[command.srvo_id] = command;
+                last_servo = command.srvo_id;
+            }
+            return length;
+        }
+        case DRVM_TXD_EP:
+        {
+            udev_pkt_drvm_sts status = {};
+            status.status = drive_status;
+            for (int i = 0; i < eN_DrvMotor; i++)
+            {
+                float speed = std::fabs(motors[i].velocity);
+                status.mtr_info[i].temp = (uint8_t)std::fmin(30.0f + speed * 0.05f, 255.0f);
+                status.mtr_info[i].current = (uint8_t)std::fmin(speed * 0.2f, 255.0f);
+                status.mtr_info[i].position = motors[i].position;
+                status.mtr_info[i].velocity = motors[i].velocity;
+            }
+            int n = length < (int)sizeof(status) ? length : (int)sizeof(status);
+            memcpy(data, &status, n);
+            return n;
+        }
+        case SRVO_TXD_EP: //Also SENS_TXD_EP
+        {
+            if (length == (int)sizeof(udev_pkt_sens_sts))
+            {
+                udev_pkt_sens_sts sensors;
+                float t = now * 1e-9f;
+                for (int i = 0; i < eN_DrvADC; i++)
+                {
+                    float volts = i == eDrvADC_Temp ? 0.75f + 0.01f * std::sin(0.1f * t) : 1.65f + std::sin(2.0f * t + i);
+                    sensors.adc_volts[i] = volts;
+                    sensors.adc_vals[i] = (uint32_t)(volts / 3.3f * 4095.0f);
+                }
+                memcpy(data, &sensors, sizeof(sensors));
+                return sizeof(sensors);
+            }
+            udev_pkt_srvo_sts status = {};
+            status.len = sizeof(servos[last_servo]);
+            memcpy(status.buf, &servos[last_servo], sizeof(servos[last_servo]));
+            status.core_temp = 40.0f;
+            int n = length < (int)sizeof(status) ? length : (int)sizeof(status);
+            memcpy(data, &status, n);
+            return n;
+        }
+        case DRVM_NTF_EP:
+        case SRVO_NTF_EP:
+        {
+            unsigned char notify[DRVM_NTF_SZ] = {};
+            memcpy(notify, endpoint == DRVM_NTF_EP ? &drive_status : &servo_status, sizeof(udev_status));
+            int n = length < (int)sizeof(notify) ? length : (int)sizeof(notify);
+            memcpy(data, notify, n);
+            return n;
+        }
+        default:
+            return 0;
+    }
+}
+
+libusb_error ChassisMockBoard::transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    *transferred = 0;
+    if (!claimed || !connected)
+        return LIBUSB_ERROR_NO_DEVICE;
+    libusb_error err = LIBUSB_SUCCESS;
+    uint64_t now = cb_now_ns();
+
+    if (is_notify(endpoint))
+    {
+        //Wait for the next injected status
+        uint64_t generation = status_generation;
+        auto injected = [&]() { return status_generation != generation || !connected; };
+        if (timeout == 0)
+            cv.wait(guard, injected);
+        else if (!cv.wait_for(guard, std::chrono::milliseconds(timeout), injected))
+            return LIBUSB_ERROR_TIMEOUT;
+        if (!connected)
+            return LIBUSB_ERROR_NO_DEVICE;
+        now = cb_now_ns();
+    }
+
+    uint64_t due = schedule(now, timeout, err);
+    guard.unlock();
+    if (due == UINT64_MAX)
+        return LIBUSB_ERROR_TIMEOUT;
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(due)));
+    if (err != LIBUSB_SUCCESS)
+        return err;
+    guard.lock();
+    if (!connected)
+        return LIBUSB_ERROR_NO_DEVICE;
+    *transferred = respond(endpoint, data, length, cb_now_ns());
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisMockBoard::prepare(CBTransportRequest *)
+{
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisMockBoard::release(CBTransportRequest *)
+{
+}
+
+libusb_error ChassisMockBoard::submit(CBTransportRequest *request)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!claimed || !connected)
+        return LIBUSB_ERROR_NO_DEVICE;
+    libusb_error err = LIBUSB_SUCCESS;
+    uint64_t due = 0;
+    //Notification reads stay parked until a status is injected
+    if (!is_notify(request->endpoint))
+        due = schedule(cb_now_ns(), request->timeout, err);
+    pending.push(request, due, err);
+    cv.notify_all();
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisMockBoard::cancel(CBTransportRequest *request)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &entry : pending)
+    {
+        if (entry.request == request)
+            pending.complete_now(entry, LIBUSB_ERROR_INTERRUPTED);
+    }
+    cv.notify_all();
+}
+
+void ChassisMockBoard::complete_later(CBTransportRequest *request, libusb_error err)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_now(request, err);
+    cv.notify_all();
+}
+
+void ChassisMockBoard::handle_events(int timeout_us)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    while (true)
+    {
+        uint64_t now = cb_now_ns();
+        uint64_t next_due = UINT64_MAX;
+        bool handled = false;
+        ChassisPendingQueue<>::Entry entry;
+        while (pending.take_due(now, entry, next_due))
+        {
+            int actual = 0;
+            if (entry.err == LIBUSB_SUCCESS)
+                actual = respond(entry.request->endpoint, entry.request->buffer, entry.request->length, now);
+            //The completion may submit again, so it runs without the lock
+            completing++;
+            guard.unlock();
+            entry.request->on_complete(entry.request, entry.err, actual);
+            guard.lock();
+            completing--;
+            handled = true;
+        }
+        if (handled || woken)
+        {
+            if (handled)
+                cv.notify_all();
+            woken = false;
+            return;
+        }
+        auto wait_until = until;
+        if (next_due != UINT64_MAX)
+        {
+            auto due = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(next_due));
+            if (due < wait_until)
+                wait_until = due;
+        }
+        if (cv.wait_until(guard, wait_until) == std::cv_status::timeout && std::chrono::steady_clock::now() >= until)
+            return;
+    }
+}
+
+void ChassisMockBoard::wake()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    woken = true;
+    cv.notify_all();
+}
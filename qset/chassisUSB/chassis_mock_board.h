@@ -0,0 +1,145 @@
+#ifndef CHASSIS_MOCK_BOARD_H
+#define CHASSIS_MOCK_BOARD_H
+
+#include "chassis_pending.h"
+#include "chassis_transport.h"
+#include "dependencies/usb_packet.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/**
+ * @file chassis_mock_board.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Board In-Process Simulator
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Timing and fault model of the simulated board
+struct CBMockConfig
+{
+    //Base time between submission and completion of every transfer
+    uint32_t latency_us = 125;
+    //Uniformly distributed extra latency (0 to `jitter_us`), transfers on one endpoint still complete in order
+    uint32_t jitter_us = 25;
+    //Bus time per transfer, transfers are serialised on the bus like on a real full speed link
+    uint32_t bus_us = 8;
+    //Probability (0 to 1) that a transfer fails with `error`
+    double error_rate = 0.0;
+    libusb_error error = LIBUSB_ERROR_IO;
+    //Probability (0 to 1) that the board never answers, the transfer then times out
+    double timeout_rate = 0.0;
+    //Seed of the latency and fault generator, runs are reproducible for a given seed
+    uint32_t seed = 1;
+};
+
+/**
+ * @class ChassisMockBoard
+ * @brief Software chassis board answering the drive, servo, sensor and notification endpoints.
+ *
+ * Drive commands drive a simple first order motor model (position, velocity, current, temperature),
+ * servo commands are echoed back in the servo status, and the ADC channels return slowly varying
+ * waveforms. Latency, jitter, bus serialisation, errors and timeouts follow `CBMockConfig`.
+ *
+ * @code
+ * ChassisMockBoard mock;
+ * ChassisBoard chassis(mock);
+ * chassis.initialize(LIBUSB_LOG_LEVEL_NONE);
+ * chassis.claimInterfaces();
+ * @endcode
+ *
+ * @note `SENS_TXD_EP` and `SRVO_TXD_EP` share one address in `usb_dev.h`, the mock tells the two
+ *       apart by the requested length (`sizeof(udev_pkt_sens_sts)` answers with sensor data).
+ */
+class ChassisMockBoard : public ChassisTransport
+{
+    public:
+        explicit ChassisMockBoard(const CBMockConfig &config = CBMockConfig());
+
+        void set_config(const CBMockConfig &config);
+        CBMockConfig get_config();
+
+        /**
+         * @brief Simulates a status change reported by the board.
+         *
+         * Pending interrupt reads on `endpoint` (`DRVM_NTF_EP` or `SRVO_NTF_EP`) complete with the
+         * status. For `DRVM_NTF_EP` the status is also reported in subsequent drive status packets.
+         */
+        void inject_status(uint8_t endpoint, udev_status status);
+
+        //Last command received for a motor / servo
+        udev_pkt_drvm_ctrl get_drive_command(eDrvMotors motor);
+        udev_pkt_srvo_ctrl get_servo_command(eChassisServo servo);
+        //Transfers answered so far (blocking and asynchronous)
+        uint64_t get_transfer_count();
+
+        /**
+         * @brief Simulates unplugging (`false`) and plugging back (`true`) the board.
+         *
+         * While unplugged every transfer fails with `LIBUSB_ERROR_NO_DEVICE` and pending transfers
+         * complete with it. Plugging back reports the reconnect to the link handler after `enumerate_us`.
+         */
+        void set_connected(bool connected, uint32_t enumerate_us = 0);
+
+        libusb_error open(libusb_log_level log_lvl) override;
+        libusb_error claim_interfaces() override;
+        libusb_error claim_interface(int interface_num) override;
+        void release_interface(int interface_num) override;
+        libusb_error transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) override;
+        libusb_error prepare(CBTransportRequest *request) override;
+        void release(CBTransportRequest *request) override;
+        libusb_error submit(CBTransportRequest *request) override;
+        void cancel(CBTransportRequest *request) override;
+        void complete_later(CBTransportRequest *request, libusb_error err) override;
+        void handle_events(int timeout_us) override;
+        void wake() override;
+        void set_link_handler(CBLinkHandler handler) override;
+        CBLinkStats get_link_stats() override;
+
+    private:
+        struct CBMockMotor
+        {
+            udev_pkt_drvm_ctrl command = {};
+            float position = 0;
+            float velocity = 0;
+        };
+
+        std::mutex lock;
+        std::condition_variable cv;
+        CBMockConfig config;
+        std::mt19937 rng;
+        bool woken = false;
+        bool claimed = false;
+        bool connected = true;
+        int completing = 0;
+        uint64_t bus_free_ns = 0;
+        uint64_t transfers = 0;
+        uint64_t status_generation = 0;
+        ChassisPendingQueue<> pending; //Parked notification reads wait for a status
+        CBLinkStats link_stats;
+        uint64_t lost_ns = 0;
+        std::mutex handler_lock;
+        CBLinkHandler link_handler;
+
+        //Board model
+        CBMockMotor motors[eN_DrvMotor];
+        uint64_t model_time_ns = 0;
+        udev_pkt_srvo_ctrl servos[eN_Servo] = {};
+        uint8_t last_servo = 0;
+        udev_status drive_status = {eDrvOK, 0};
+        udev_status servo_status = {eDrvOK, 0};
+
+        //All of the following expect `lock` to be held
+        uint64_t schedule(uint64_t now, unsigned int timeout, libusb_error &err);
+        void step_model(uint64_t now);
+        int respond(uint8_t endpoint, unsigned char *data, int length, uint64_t now);
+        static bool is_notify(uint8_t endpoint);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CHASSIS_PENDING_H
+#define CHASSIS_PENDING_H
+
+#include "chassis_transport.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file chassis_pending.h
+ * @author Kian Cossettini
+ * @brief Completion queue of the simulated transports
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @class ChassisPendingQueue
+ * @brief Submitted requests of `ChassisMockBoard` and `ChassisReplayTransport` with their completion time.
+ *
+ * `take_due()` hands out due entries in (due time, submission) order, and a transfer is never due
+ * before an earlier one on the same endpoint, so every endpoint stays FIFO like a real bulk pipe.
+ * `push_now()` and `complete_now()` skip the line, like a libusb cancellation.
+ *
+ * Not thread safe, the transport guards it with its own lock.
+ *
+ * @tparam Payload Backend data handed to the completion (e.g. the recorded transfer of a replay).
+ */
+template <typename Payload = std::nullptr_t>
+class ChassisPendingQueue
+{
+    public:
+        struct Entry
+        {
+            CBTransportRequest *request;
+            uint64_t due_ns; //0 = parked until `schedule()`
+            libusb_error err;
+            Payload payload;
+            uint64_t seq;
+        };
+
+        //Queues `request` to complete with `err` at `due_ns` (0 = parked)
+        void push(CBTransportRequest *request, uint64_t due_ns, libusb_error err, const Payload &payload = Payload())
+        {
+            entries.push_back({request, fifo_due(request->endpoint, next_seq, due_ns), err, payload, next_seq});
+            next_seq++;
+        }
+        //Queues `request` to complete with `err` on the next `take_due()`, ahead of its endpoint
+        void push_now(CBTransportRequest *request, libusb_error err, const Payload &payload = Payload())
+        {
+            entries.push_back({request, 1, err, payload, next_seq});
+            next_seq++;
+        }
+        //Sets the completion time of a parked entry
+        void schedule(Entry &entry, uint64_t due_ns)
+        {
+            entry.due_ns = fifo_due(entry.request->endpoint, entry.seq, due_ns);
+        }
+        //Completes `entry` with `err` on the next `take_due()`, ahead of its endpoint
+        static void complete_now(Entry &entry, libusb_error err)
+        {
+            entry.err = err;
+            entry.due_ns = 1;
+        }
+
+        /**
+         * @brief Removes the first entry due at `now`.
+         *
+         * @param out The removed entry.
+         * @param next_due Lowered to the due time of the earliest entry not due yet.
+         * @return False if no entry is due.
+         */
+        bool take_due(uint64_t now, Entry &out, uint64_t &next_due)
+        {
+            size_t first = entries.size();
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                uint64_t due = entries[i].due_ns;
+                if (due == 0)
+                    continue;
+                if (due > now)
+                {
+                    if (due < next_due)
+                        next_due = due;
+                }
+                //Entries are kept in submission order, so ties go to the earliest
+                else if (first == entries.size() || due < entries[first].due_ns)
+                    first = i;
+            }
+            if (first == entries.size())
+                return false;
+            out = entries[first];
+            entries.erase(entries.begin() + first);
+            return true;
+        }
+
+        typename std::vector<Entry>::iterator begin() { return entries.begin(); }
+        typename std::vector<Entry>::iterator end() { return entries.end(); }
+
+    private:
+        std::vector<Entry> entries;
+        uint64_t next_seq = 0;
+
+        //`due_ns` delayed behind the transfers submitted to `endpoint` before `seq`, except lost ones
+        //(due `UINT64_MAX`) which would stall the endpoint for good
+        uint64_t fifo_due(uint8_t endpoint, uint64_t seq, uint64_t due_ns) const
+        {
+            if (due_ns == 0)
+                return 0;
+            for (const Entry &entry : entries)
+            {
+                if (entry.seq < seq && entry.request->endpoint == endpoint && entry.due_ns > due_ns
+                    && entry.due_ns != UINT64_MAX)
+                    due_ns = entry.due_ns;
+            }
+            return due_ns;
+        }
+};
+
+#endif
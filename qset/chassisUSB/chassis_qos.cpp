@@ -0,0 +1,178 @@
+#include "chassis_qos.h"
+
+void ChassisQosScheduler::configure(const CBQosConfig &config)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    this->config = config;
+    for (int c = 0; c < eN_QosClass; c++)
+    {
+        if (this->config.burst[c] < 1)
+            this->config.burst[c] = 1;
+        queues[c].tokens = this->config.burst[c];
+        queues[c].refill_ns = 0;
+    }
+    active = config.max_in_flight > 0;
+}
+
+CBQosConfig ChassisQosScheduler::get_config()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return config;
+}
+
+void ChassisQosScheduler::append(CBQosQueue &queue, CBQosItem *item)
+{
+    item->next = nullptr;
+    if (queue.tail)
+        queue.tail->next = item;
+    else
+        queue.head = item;
+    queue.tail = item;
+}
+
+bool ChassisQosScheduler::unlink(CBQosQueue &queue, CBQosItem *item)
+{
+    CBQosItem *prev = nullptr;
+    for (CBQosItem *it = queue.head; it; prev = it, it = it->next)
+    {
+        if (it != item)
+            continue;
+        if (prev)
+            prev->next = it->next;
+        else
+            queue.head = it->next;
+        if (queue.tail == it)
+            queue.tail = prev;
+        it->next = nullptr;
+        return true;
+    }
+    return false;
+}
+
+void ChassisQosScheduler::push(CBQosItem *item, eCBQosClass qos_class, uint64_t now_ns)
+{
+    item->qos_class = qos_class;
+    item->enqueue_ns = now_ns;
+    item->counted = false;
+    std::lock_guard<std::mutex> guard(lock);
+    item->blocked = bus_in_flight >= config.max_in_flight;
+    for (int c = 0; c <= qos_class && !item->blocked; c++)
+        item->blocked = queues[c].head != nullptr;
+    append(queues[qos_class], item);
+    queues[qos_class].stats.waiting++;
+    queued_items++;
+}
+
+void ChassisQosScheduler::refill(CBQosQueue &queue, int qos_class, uint64_t now_ns)
+{
+    double rate = config.rate_budget[qos_class];
+    if (rate <= 0)
+        return;
+    if (queue.refill_ns != 0 && now_ns > queue.refill_ns)
+    {
+        queue.tokens += (now_ns - queue.refill_ns) * rate / 1e9;
+        if (queue.tokens > config.burst[qos_class])
+            queue.tokens = config.burst[qos_class];
+    }
+    queue.refill_ns = now_ns;
+}
+
+void ChassisQosScheduler::account(CBQosQueue &queue, CBQosItem *item, uint64_t now_ns)
+{
+    uint64_t waited = now_ns > item->enqueue_ns ? now_ns - item->enqueue_ns : 0;
+    CBQosClassStats &stats = queue.stats;
+    stats.transfers++;
+    stats.waiting--;
+    if (item->blocked)
+        stats.queued++;
+    queue.total_queue_ns += waited;
+    if (waited > stats.max_queue_ns)
+        stats.max_queue_ns = waited;
+}
+
+ChassisQosScheduler::CBQosItem *ChassisQosScheduler::pop(uint64_t now_ns)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (CBQosItem *item = cancelled.head)
+    {
+        unlink(cancelled, item);
+        queues[item->qos_class].stats.waiting--;
+        queued_items--;
+        return item;
+    }
+    if (bus_in_flight >= config.max_in_flight && active)
+        return nullptr;
+    for (int c = 0; c < eN_QosClass; c++)
+    {
+        CBQosQueue &queue = queues[c];
+        CBQosItem *item = queue.head;
+        if (item == nullptr)
+            continue;
+        refill(queue, c, now_ns);
+        if (config.rate_budget[c] > 0)
+        {
+            if (queue.tokens < 1)
+                continue;
+            queue.tokens -= 1;
+        }
+        unlink(queue, item);
+        queued_items--;
+        account(queue, item, now_ns);
+        item->counted = true;
+        bus_in_flight++;
+        return item;
+    }
+    return nullptr;
+}
+
+void ChassisQosScheduler::complete(CBQosItem *item)
+{
+    if (!item->counted)
+        return;
+    std::lock_guard<std::mutex> guard(lock);
+    item->counted = false;
+    bus_in_flight--;
+}
+
+bool ChassisQosScheduler::cancel(CBQosItem *item)
+{
+    item->cancelled = true;
+    std::lock_guard<std::mutex> guard(lock);
+    if (!unlink(queues[item->qos_class], item))
+        return false;
+    append(cancelled, item);
+    return true;
+}
+
+bool ChassisQosScheduler::has_waiting()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (int c = 0; c < eN_QosClass; c++)
+        if (queues[c].head && config.rate_budget[c] > 0)
+            return true;
+    return false;
+}
+
+CBQosStats ChassisQosScheduler::get_stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    CBQosStats stats;
+    for (int c = 0; c < eN_QosClass; c++)
+    {
+        stats[c] = queues[c].stats;
+        stats[c].mean_queue_ns = stats[c].transfers ? queues[c].total_queue_ns / stats[c].transfers : 0;
+    }
+    return stats;
+}
+
+void ChassisQosScheduler::reset_stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (CBQosQueue &queue : queues)
+    {
+        uint64_t waiting = queue.stats.waiting;
+        queue.stats = {};
+        queue.stats.waiting = waiting;
+        queue.total_queue_ns = 0;
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef CHASSIS_QOS_H
+#define CHASSIS_QOS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @file chassis_qos.h
+ * @author Kian Cossettini
+ * @brief Priority classes and rate budgets for the asynchronous transfers
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Transfer priority classes, highest first
+enum eCBQosClass
+{
+    eCBQosDrive,     //Drive motor commands (`DRVM_RXD_EP`)
+    eCBQosServo,     //Servo commands (`SRVO_RXD_EP`)
+    eCBQosTelemetry, //Status and sensor reads
+    eN_QosClass
+};
+
+struct CBQosConfig
+{
+    //Transfers on the bus at once across every endpoint, 0 disables the scheduler
+    int max_in_flight = 0;
+    //Transfers per second allowed per class, 0 = unlimited
+    double rate_budget[eN_QosClass] = {0, 0, 0};
+    //Transfers a class may send back to back once it has been idle
+    double burst[eN_QosClass] = {4, 4, 4};
+};
+
+struct CBQosClassStats
+{
+    uint64_t transfers;      //Sent to the bus
+    uint64_t queued;         //Of those, how many had to wait
+    uint64_t waiting;        //Currently queued
+    uint64_t mean_queue_ns;  //Time spent queued, averaged over every transfer of the class
+    uint64_t max_queue_ns;
+};
+
+using CBQosStats = std::array<CBQosClassStats, eN_QosClass>;
+
+/**
+ * @class ChassisQosScheduler
+ * @brief Decides which queued transfer goes on the bus next.
+ *
+ * Bounds the transfers in flight across all endpoints. Whenever the bus is full, new transfers wait in
+ * one queue per class, and a freed place always goes to the highest class with work queued, so drive
+ * commands overtake any telemetry already waiting and only ever wait for `max_in_flight` transfers to
+ * complete. Each class also has a token bucket rate budget, a class out of budget lets lower ones go.
+ *
+ * Used by `ChassisAsyncEngine`, whose transfer slots embed the `CBQosItem`. Thread safe.
+ */
+class ChassisQosScheduler
+{
+    public:
+        //Queue entry, owned by the caller
+        struct CBQosItem
+        {
+            CBQosItem *next = nullptr;
+            void *user_data = nullptr;
+            eCBQosClass qos_class = eCBQosTelemetry;
+            uint64_t enqueue_ns = 0;
+            bool counted = false;         //Holds a place on the bus
+            bool blocked = false;         //Could not go straight to the bus when pushed
+            std::atomic<bool> cancelled{false};
+            CBQosItem() = default;
+            //Only so the owner can sit in a resizable container, a queued item is never copied
+            CBQosItem(const CBQosItem &) {}
+        };
+
+        void configure(const CBQosConfig &config);
+        CBQosConfig get_config();
+        bool enabled() const { return active.load(std::memory_order_relaxed); }
+        //No item queued, checked without locking
+        bool idle() const { return queued_items.load(std::memory_order_acquire) == 0; }
+
+        //Queues an item, `pop()` hands it back once it may go on the bus
+        void push(CBQosItem *item, eCBQosClass qos_class, uint64_t now_ns);
+        //Next item to submit, cancelled ones first, nullptr if none may go yet
+        CBQosItem *pop(uint64_t now_ns);
+        //Releases the place of a completed item
+        void complete(CBQosItem *item);
+        //Flags an item cancelled, returns true if it was still queued (it is then popped right away)
+        bool cancel(CBQosItem *item);
+        //Whether items wait for a rate budget, i.e. `pop()` has to be retried without a completion
+        bool has_waiting();
+
+        CBQosStats get_stats();
+        void reset_stats();
+
+    private:
+        struct CBQosQueue
+        {
+            CBQosItem *head = nullptr;
+            CBQosItem *tail = nullptr;
+            double tokens = 0;
+            uint64_t refill_ns = 0;
+            CBQosClassStats stats = {};
+            uint64_t total_queue_ns = 0;
+        };
+
+        std::mutex lock;
+        std::atomic<bool> active{false};
+        std::atomic<int> queued_items{0};
+        CBQosConfig config;
+        CBQosQueue queues[eN_QosClass];
+        CBQosQueue cancelled;
+        int bus_in_flight = 0;
+
+        static void append(CBQosQueue &queue, CBQosItem *item);
+        static bool unlink(CBQosQueue &queue, CBQosItem *item);
+        void refill(CBQosQueue &queue, int qos_class, uint64_t now_ns);
+        void account(CBQosQueue &queue, CBQosItem *item, uint64_t now_ns);
+};
+
+#endif
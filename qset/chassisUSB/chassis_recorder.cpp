@@ -0,0 +1,222 @@
+#include "chassis_recorder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char record_magic[8] = "CBREC01";
+static constexpr uint32_t record_version = 1;
+
+//Size of a record including its header, keeps every record 8 byte aligned
+static size_t record_size(size_t length)
+{
+    return (sizeof(CBRecordHeader) + length + 7) & ~(size_t)7;
+}
+
+ChassisRecorder::~ChassisRecorder()
+{
+    close();
+}
+
+int ChassisRecorder::open(const char *path, size_t capacity)
+{
+    if (is_open())
+        return EBUSY;
+    if (capacity < sizeof(CBRecordFileHeader))
+        return EINVAL;
+
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return errno;
+
+    //Reserve the blocks up front so recording never has to wait on the filesystem allocator
+    int err = posix_fallocate(fd, 0, capacity);
+    if (err == EOPNOTSUPP || err == EINVAL)
+        err = ftruncate(fd, capacity) == 0 ? 0 : errno;
+    if (err != 0)
+    {
+        ::close(fd);
+        fd = -1;
+        return err;
+    }
+
+    void *map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        err = errno;
+        ::close(fd);
+        fd = -1;
+        return err;
+    }
+    madvise(map, capacity, MADV_SEQUENTIAL);
+    base = static_cast<unsigned char*>(map);
+    this->capacity = capacity;
+
+    CBRecordFileHeader *header = reinterpret_cast<CBRecordFileHeader*>(base);
+    memcpy(header->magic, record_magic, sizeof(header->magic));
+    header->version = record_version;
+    header->header_size = sizeof(CBRecordFileHeader);
+    header->capacity = capacity;
+    header->end = 0;
+    write_pos = sizeof(CBRecordFileHeader);
+    dropped = 0;
+    return 0;
+}
+
+void ChassisRecorder::close()
+{
+    if (!is_open())
+        return;
+    size_t end = get_size();
+    reinterpret_cast<CBRecordFileHeader*>(base)->end = end;
+    msync(base, end, MS_ASYNC);
+    munmap(base, capacity);
+    //If trimming fails the file keeps its preallocated size, readers stop at `end` anyway
+    int trim_err = ftruncate(fd, end);
+    (void)trim_err;
+    ::close(fd);
+    fd = -1;
+    base = nullptr;
+    capacity = 0;
+}
+
+bool ChassisRecorder::is_open() const
+{
+    return base != nullptr;
+}
+
+bool ChassisRecorder::record(uint8_t endpoint, int status, const void *payload, int length, uint64_t timestamp_ns, uint64_t duration_ns)
+{
+    if (base == nullptr || length < 0 || length > 0xFF)
+        return false;
+    size_t size = record_size(length);
+    size_t pos = write_pos.fetch_add(size, std::memory_order_relaxed);
+    if (pos + size > capacity)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    CBRecordHeader *header = reinterpret_cast<CBRecordHeader*>(base + pos);
+    header->timestamp_ns = timestamp_ns;
+    header->duration_ns = (uint32_t)std::min<uint64_t>(duration_ns, UINT32_MAX);
+    header->endpoint = endpoint;
+    header->length = (uint8_t)length;
+    header->status = (int8_t)status;
+    if (length > 0)
+        memcpy(base + pos + sizeof(CBRecordHeader), payload, length);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->committed = 1;
+    return true;
+}
+
+size_t ChassisRecorder::get_size() const
+{
+    return std::min(write_pos.load(std::memory_order_relaxed), capacity);
+}
+
+uint64_t ChassisRecorder::get_dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+ChassisRecordReader::~ChassisRecordReader()
+{
+    close();
+}
+
+int ChassisRecordReader::open(const char *path)
+{
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return errno;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        return err;
+    }
+    if ((size_t)st.st_size < sizeof(CBRecordFileHeader))
+    {
+        ::close(fd);
+        return EINVAL;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = map == MAP_FAILED ? errno : 0;
+    ::close(fd);
+    if (err != 0)
+        return err;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    base = static_cast<const unsigned char*>(map);
+    size = st.st_size;
+
+    const CBRecordFileHeader *header = reinterpret_cast<const CBRecordFileHeader*>(base);
+    if (memcmp(header->magic, record_magic, sizeof(header->magic)) != 0 || header->version != record_version)
+    {
+        close();
+        return EINVAL;
+    }
+    //An unfinished recording has no end offset, the iterator then stops at the first uncommitted record
+    data_end = header->end != 0 && header->end <= size ? header->end : size;
+    return 0;
+}
+
+void ChassisRecordReader::close()
+{
+    if (base != nullptr)
+        munmap(const_cast<unsigned char*>(base), size);
+    base = nullptr;
+    size = 0;
+    data_end = 0;
+}
+
+ChassisRecordReader::iterator ChassisRecordReader::begin() const
+{
+    if (base == nullptr)
+        return iterator(nullptr, nullptr);
+    return iterator(base + sizeof(CBRecordFileHeader), base + data_end);
+}
+
+ChassisRecordReader::iterator ChassisRecordReader::end() const
+{
+    if (base == nullptr)
+        return iterator(nullptr, nullptr);
+    return iterator(base + data_end, base + data_end);
+}
+
+ChassisRecordReader::iterator::iterator(const unsigned char *pos, const unsigned char *end) : pos(pos), end(end)
+{
+    validate();
+}
+
+CBRecordView ChassisRecordReader::iterator::operator*() const
+{
+    return {reinterpret_cast<const CBRecordHeader*>(pos), pos + sizeof(CBRecordHeader)};
+}
+
+ChassisRecordReader::iterator& ChassisRecordReader::iterator::operator++()
+{
+    pos += record_size(reinterpret_cast<const CBRecordHeader*>(pos)->length);
+    validate();
+    return *this;
+}
+
+bool ChassisRecordReader::iterator::operator!=(const iterator &other) const
+{
+    return pos != other.pos;
+}
+
+void ChassisRecordReader::iterator::validate()
+{
+    if (pos == end)
+        return;
+    const CBRecordHeader *header = reinterpret_cast<const CBRecordHeader*>(pos);
+    if ((size_t)(end - pos) < sizeof(CBRecordHeader) || !header->committed || (size_t)(end - pos) < record_size(header->length))
+        pos = end;
+}
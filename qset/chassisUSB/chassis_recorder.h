@@ -0,0 +1,153 @@
+#ifndef CHASSIS_RECORDER_H
+#define CHASSIS_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @file chassis_recorder.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Binary Telemetry Recorder
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//File header at offset 0 of every recording
+struct CBRecordFileHeader
+{
+    char magic[8];        //"CBREC01"
+    uint32_t version;
+    uint32_t header_size; //sizeof(CBRecordFileHeader), records start here
+    uint64_t capacity;    //Size of the preallocated file
+    uint64_t end;         //Offset after the last record (written when the recorder is closed)
+};
+
+/**
+ * @brief Header of one record. The raw packet (packed struct from `usb_packet.h`) follows it.
+ *
+ * Records are 8 byte aligned. A record is only valid once `committed` is set, a reader stops
+ * at the first uncommitted record (e.g. after a crash while recording).
+ */
+struct CBRecordHeader
+{
+    uint64_t timestamp_ns; //Host monotonic time at completion (`cb_now_ns()`)
+    uint32_t duration_ns;  //Time between submission and completion (saturates)
+    uint8_t endpoint;      //Endpoint address, bit 7 set for device to host
+    uint8_t length;        //Payload length in bytes
+    int8_t status;         //libusb_error of the transfer
+    uint8_t committed;
+};
+static_assert(sizeof(CBRecordHeader) == 16, "CBRecordHeader must stay 16 bytes");
+
+/**
+ * @class ChassisRecorder
+ * @brief Appends transfers to a preallocated, memory-mapped file.
+ *
+ * Space is reserved with a single atomic add and the packet is copied straight from the transfer
+ * buffer into the mapping, so recording costs no system call and no intermediate buffer. The kernel
+ * writes the pages back in the background. Several threads may record at the same time.
+ * When the file is full, further records are dropped and counted.
+ */
+class ChassisRecorder
+{
+    public:
+        ChassisRecorder() = default;
+        ChassisRecorder(const ChassisRecorder&) = delete;
+        ChassisRecorder& operator=(const ChassisRecorder&) = delete;
+        ~ChassisRecorder();
+
+        /**
+         * @brief Creates (or truncates) `path` and preallocates and maps `capacity` bytes.
+         *
+         * @return 0 on success, otherwise the errno of the failing call.
+         */
+        int open(const char *path, size_t capacity);
+
+        /**
+         * @brief Writes the end offset, unmaps and trims the file to the recorded size.
+         *
+         * Must not be called while another thread may still be recording.
+         */
+        void close();
+
+        bool is_open() const;
+
+        //Appends one record. Returns false if the recorder is closed or full.
+        bool record(uint8_t endpoint, int status, const void *payload, int length, uint64_t timestamp_ns, uint64_t duration_ns);
+
+        //Bytes used so far, including the file header
+        size_t get_size() const;
+        //Records dropped because the file was full
+        uint64_t get_dropped() const;
+
+    private:
+        int fd = -1;
+        unsigned char *base = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> write_pos{0};
+        std::atomic<uint64_t> dropped{0};
+};
+
+//One record as seen by the reader, the views point into the mapped file
+struct CBRecordView
+{
+    const CBRecordHeader *header;
+    const unsigned char *payload;
+
+    //Returns the payload as a packet struct, or nullptr if the size does not match
+    template <typename Packet>
+    const Packet *as() const
+    {
+        return header->length == sizeof(Packet) ? reinterpret_cast<const Packet*>(payload) : nullptr;
+    }
+};
+
+/**
+ * @class ChassisRecordReader
+ * @brief Maps a recording read-only and iterates over its records without copying them.
+ *
+ * @code
+ * ChassisRecordReader reader;
+ * if (reader.open("run.cbrec") == 0)
+ *     for (CBRecordView rec : reader)
+ *         if (const udev_pkt_drvm_sts *sts = rec.as<udev_pkt_drvm_sts>()) { ... }
+ * @endcode
+ */
+class ChassisRecordReader
+{
+    public:
+        class iterator
+        {
+            public:
+                iterator(const unsigned char *pos, const unsigned char *end);
+                CBRecordView operator*() const;
+                iterator& operator++();
+                bool operator!=(const iterator &other) const;
+            private:
+                const unsigned char *pos;
+                const unsigned char *end;
+                void validate();
+        };
+
+        ChassisRecordReader() = default;
+        ChassisRecordReader(const ChassisRecordReader&) = delete;
+        ChassisRecordReader& operator=(const ChassisRecordReader&) = delete;
+        ~ChassisRecordReader();
+
+        //Returns 0 on success, `EINVAL` if the file is not a recording, otherwise an errno
+        int open(const char *path);
+        void close();
+        iterator begin() const;
+        iterator end() const;
+
+    private:
+        const unsigned char *base = nullptr;
+        size_t size = 0;
+        size_t data_end = 0;
+};
+
+#endif
@@ -0,0 +1,268 @@
+#include "chassis_replay.h"
+#include "chassis_clock.h"
+#include "dependencies/usb_dev.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+//Streams are keyed by endpoint and transfer length
+static uint32_t stream_key(uint8_t endpoint, int length)
+{
+    return (uint32_t)endpoint << 16 | (uint32_t)(length & 0xFFFF);
+}
+
+static bool is_notify(uint8_t endpoint)
+{
+    return endpoint == DRVM_NTF_EP || endpoint == SRVO_NTF_EP;
+}
+
+ChassisReplayTransport::ChassisReplayTransport(const CBReplayConfig &config) : config(config)
+{
+}
+
+int ChassisReplayTransport::load(const char *path)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    records.clear();
+    int err = reader.open(path);
+    if (err != 0)
+        return err;
+
+    uint64_t first_ns = 0, last_ns = 0;
+    bool any = false;
+    for (CBRecordView view : reader)
+    {
+        const CBRecordHeader *header = view.header;
+        if (!any)
+            first_ns = header->timestamp_ns;
+        any = true;
+        last_ns = header->timestamp_ns;
+        uint64_t offset = header->timestamp_ns > first_ns ? header->timestamp_ns - first_ns : 0;
+        records[header->endpoint].push_back({offset, header->duration_ns, header->status, header->length, view.payload});
+    }
+    if (!any)
+    {
+        reader.close();
+        return EINVAL;
+    }
+    //A looping stream starts its next pass one recording length later
+    span_ns = last_ns - first_ns + 1;
+    cursors.clear();
+    stats = {};
+    start_ns = cb_now_ns();
+    return 0;
+}
+
+void ChassisReplayTransport::rewind()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    cursors.clear();
+    stats = {};
+    start_ns = cb_now_ns();
+}
+
+CBReplayStats ChassisReplayTransport::get_stats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+libusb_error ChassisReplayTransport::open(libusb_log_level)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return records.empty() ? LIBUSB_ERROR_NOT_FOUND : LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisReplayTransport::claim_interfaces()
+{
+    return LIBUSB_SUCCESS;
+}
+
+libusb_error ChassisReplayTransport::claim_interface(int interface_num)
+{
+    return interface_num < UDEV_INTERFACES ? LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+}
+
+void ChassisReplayTransport::release_interface(int)
+{
+}
+
+ChassisReplayTransport::CBReplayAnswer ChassisReplayTransport::answer(uint8_t endpoint, const unsigned char *data, int length,
+                                                                      unsigned int timeout, uint64_t now)
+{
+    bool notify = is_notify(endpoint);
+    auto found = records.find(endpoint);
+    if (found == records.end())
+        return {notify ? 0 : now, notify ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE, nullptr};
+    const std::vector<CBReplayRecord> &list = found->second;
+    CBReplayCursor &cursor = cursors[stream_key(endpoint, length)];
+
+    //Next record of this stream: same length, or a failure nobody can tell apart
+    const CBReplayRecord *record = nullptr;
+    size_t index = cursor.next;
+    uint64_t wraps = cursor.wraps;
+    for (size_t scanned = 0; scanned <= list.size() && record == nullptr; scanned++)
+    {
+        if (index == list.size())
+        {
+            if (!config.loop)
+                break;
+            index = 0;
+            wraps++;
+        }
+        const CBReplayRecord &candidate = list[index++];
+        if (candidate.length == length || candidate.status != LIBUSB_SUCCESS)
+            record = &candidate;
+    }
+    if (record == nullptr)
+    {
+        //No more notifications stay parked until cancelled, everything else fails like an unplugged board
+        if (notify)
+            return {0, LIBUSB_SUCCESS, nullptr};
+        stats.exhausted++;
+        return {now, LIBUSB_ERROR_NO_DEVICE, nullptr};
+    }
+
+    uint64_t due = now;
+    if (config.speed > 0)
+    {
+        due = now + (uint64_t)(record->duration_ns / config.speed);
+        if (notify || (config.paced && (endpoint & LIBUSB_ENDPOINT_IN)))
+        {
+            uint64_t recorded = start_ns + (uint64_t)((record->offset_ns + wraps * span_ns) / config.speed);
+            if (recorded > due)
+                due = recorded;
+        }
+    }
+    //A read timing out before its record is due leaves the record for the next one
+    if (timeout != 0 && due > now + timeout * 1000000ull)
+        return {now + timeout * 1000000ull, LIBUSB_ERROR_TIMEOUT, nullptr};
+
+    cursor.next = index;
+    cursor.wraps = wraps;
+    stats.replayed++;
+    if (!(endpoint & LIBUSB_ENDPOINT_IN) && data
+        && (record->length != length || memcmp(record->payload, data, length) != 0))
+        stats.diverged++;
+    return {due, (libusb_error)record->status, record};
+}
+
+int ChassisReplayTransport::deliver(uint8_t endpoint, const CBReplayAnswer &answer, unsigned char *data, int length)
+{
+    if (!(endpoint & LIBUSB_ENDPOINT_IN))
+        return length;
+    if (answer.record == nullptr)
+        return 0;
+    int n = answer.record->length < length ? answer.record->length : length;
+    memcpy(data, answer.record->payload, n);
+    return n;
+}
+
+libusb_error ChassisReplayTransport::transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    *transferred = 0;
+    CBReplayAnswer result = answer(endpoint, data, length, timeout, cb_now_ns());
+    guard.unlock();
+    if (result.due_ns == 0)
+    {
+        //Blocking read of an exhausted notification stream, waits out its timeout
+        if (timeout == 0)
+            return LIBUSB_ERROR_NO_DEVICE;
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        return LIBUSB_ERROR_TIMEOUT;
+    }
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(result.due_ns)));
+    if (result.err == LIBUSB_SUCCESS)
+        *transferred = deliver(endpoint, result, data, length);
+    return result.err;
+}
+
+libusb_error ChassisReplayTransport::prepare(CBTransportRequest *)
+{
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisReplayTransport::release(CBTransportRequest *)
+{
+}
+
+libusb_error ChassisReplayTransport::submit(CBTransportRequest *request)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    bool is_in = request->endpoint & LIBUSB_ENDPOINT_IN;
+    CBReplayAnswer result = answer(request->endpoint, is_in ? nullptr : request->buffer, request->length,
+                                   request->timeout, cb_now_ns());
+    pending.push(request, result.due_ns, result.err, result.record);
+    cv.notify_all();
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisReplayTransport::cancel(CBTransportRequest *request)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &entry : pending)
+    {
+        if (entry.request == request)
+        {
+            pending.complete_now(entry, LIBUSB_ERROR_INTERRUPTED);
+            entry.payload = nullptr;
+        }
+    }
+    cv.notify_all();
+}
+
+void ChassisReplayTransport::complete_later(CBTransportRequest *request, libusb_error err)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_now(request, err);
+    cv.notify_all();
+}
+
+void ChassisReplayTransport::handle_events(int timeout_us)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    while (true)
+    {
+        uint64_t now = cb_now_ns();
+        uint64_t next_due = UINT64_MAX;
+        bool handled = false;
+        ChassisPendingQueue<const CBReplayRecord*>::Entry entry;
+        while (pending.take_due(now, entry, next_due))
+        {
+            CBTransportRequest *request = entry.request;
+            CBReplayAnswer answer = {entry.due_ns, entry.err, entry.payload};
+            int actual = 0;
+            if (answer.err == LIBUSB_SUCCESS)
+                actual = deliver(request->endpoint, answer, request->buffer, request->length);
+            //The completion may submit again, so it runs without the lock
+            guard.unlock();
+            request->on_complete(request, answer.err, actual);
+            guard.lock();
+            handled = true;
+        }
+        if (handled || woken)
+        {
+            woken = false;
+            return;
+        }
+        auto wait_until = until;
+        if (next_due != UINT64_MAX)
+        {
+            auto due = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(next_due));
+            if (due < wait_until)
+                wait_until = due;
+        }
+        if (cv.wait_until(guard, wait_until) == std::cv_status::timeout && std::chrono::steady_clock::now() >= until)
+            return;
+    }
+}
+
+void ChassisReplayTransport::wake()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    woken = true;
+    cv.notify_all();
+}
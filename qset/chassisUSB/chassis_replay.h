@@ -0,0 +1,128 @@
+#ifndef CHASSIS_REPLAY_H
+#define CHASSIS_REPLAY_H
+
+#include "chassis_pending.h"
+#include "chassis_recorder.h"
+#include "chassis_transport.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * @file chassis_replay.h
+ * @author Kian Cossettini
+ * @brief Transport answering from a recording
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+struct CBReplayConfig
+{
+    //1 = recorded timing, 2 = twice as fast, 0 = every transfer completes right away
+    double speed = 1.0;
+    //Board to host packets are not delivered before their recorded offset from the first record,
+    //so polling faster than the recording does not read ahead of it (notifications are always paced)
+    bool paced = false;
+    //Starts an exhausted stream over instead of failing with `LIBUSB_ERROR_NO_DEVICE`
+    bool loop = false;
+};
+
+struct CBReplayStats
+{
+    uint64_t replayed;  //Transfers answered from the recording
+    uint64_t diverged;  //Host to board payloads that differ from the recorded ones
+    uint64_t exhausted; //Transfers failed because their stream ran out
+};
+
+/**
+ * @class ChassisReplayTransport
+ * @brief Replays a `ChassisRecorder` capture in place of the board.
+ *
+ * Record a session on the robot with `ChassisBoard::attach_recorder()`, then construct the board with
+ * this transport to run the same control code against the captured traffic, offline and repeatably.
+ * Every transfer takes the next record of its stream (endpoint and length, as the servo and sensor
+ * packets share an endpoint) and completes with its status and payload after its recorded duration,
+ * scaled by `speed`. Writes are only checked against the recording (`diverged`), they do not change
+ * what is read back. Failed reads on a shared endpoint are replayed to every stream of that endpoint.
+ * Transfers due together complete in submission order, and each endpoint completes in order.
+ *
+ * @code
+ * ChassisReplayTransport replay;
+ * replay.load("field.cbrec");
+ * ChassisBoard chassis(replay);
+ * @endcode
+ */
+class ChassisReplayTransport : public ChassisTransport
+{
+    public:
+        explicit ChassisReplayTransport(const CBReplayConfig &config = CBReplayConfig());
+
+        /**
+         * @brief Loads a recording and rewinds to its start.
+         *
+         * @return 0 on success, `EINVAL` if the file is not a recording or holds no transfers, otherwise an errno.
+         */
+        int load(const char *path);
+        //Rewinds every stream, the timing restarts from now
+        void rewind();
+        CBReplayStats get_stats();
+
+        libusb_error open(libusb_log_level log_lvl) override;
+        libusb_error claim_interfaces() override;
+        libusb_error claim_interface(int interface_num) override;
+        void release_interface(int interface_num) override;
+        libusb_error transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) override;
+        libusb_error prepare(CBTransportRequest *request) override;
+        void release(CBTransportRequest *request) override;
+        libusb_error submit(CBTransportRequest *request) override;
+        void cancel(CBTransportRequest *request) override;
+        void complete_later(CBTransportRequest *request, libusb_error err) override;
+        void handle_events(int timeout_us) override;
+        void wake() override;
+
+    private:
+        struct CBReplayRecord
+        {
+            uint64_t offset_ns; //Completion time from the first record
+            uint32_t duration_ns;
+            int status;
+            int length;
+            const unsigned char *payload; //Into the reader mapping
+        };
+        //Position of one stream (endpoint and length) in the records of its endpoint
+        struct CBReplayCursor
+        {
+            size_t next = 0;
+            uint64_t wraps = 0;
+        };
+        //Transfer resolved against the recording
+        struct CBReplayAnswer
+        {
+            uint64_t due_ns;
+            libusb_error err;
+            const CBReplayRecord *record;
+        };
+
+        CBReplayConfig config;
+        ChassisRecordReader reader;
+        std::mutex lock;
+        std::condition_variable cv;
+        bool woken = false;
+        uint64_t start_ns = 0;
+        uint64_t span_ns = 0;
+        std::map<uint8_t, std::vector<CBReplayRecord>> records;
+        std::map<uint32_t, CBReplayCursor> cursors;
+        ChassisPendingQueue<const CBReplayRecord*> pending; //Exhausted notification streams stay parked
+        CBReplayStats stats = {};
+
+        //Expects `lock` to be held
+        CBReplayAnswer answer(uint8_t endpoint, const unsigned char *data, int length, unsigned int timeout, uint64_t now);
+        //Bytes transferred by a successful answer, copies the recorded payload of a read into `data`
+        static int deliver(uint8_t endpoint, const CBReplayAnswer &answer, unsigned char *data, int length);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef CHASSIS_RING_H
+#define CHASSIS_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @file chassis_ring.h
+ * @author Kian Cossettini
+ * @brief Fixed capacity single producer / single consumer ring buffer
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @class ChassisSPSCRing
+ * @brief Lock-free, allocation-free ring with one producer thread and one consumer thread.
+ *
+ * The storage is embedded in the object, so nothing is allocated after construction.
+ * Head and tail live on separate cache lines to keep the two threads from false sharing.
+ *
+ * @tparam T Trivially copyable element type.
+ * @tparam N Capacity, must be a power of two.
+ */
+template <typename T, size_t N>
+class ChassisSPSCRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ChassisSPSCRing capacity must be a power of two");
+
+    private:
+        static constexpr size_t mask = N - 1;
+        alignas(64) std::atomic<size_t> head{0}; //Next slot written by the producer
+        alignas(64) std::atomic<size_t> tail{0}; //Next slot read by the consumer
+        alignas(64) T items[N];
+
+    public:
+        //Producer only. Returns false (and drops the item) when the ring is full.
+        bool push(const T &item)
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == N)
+                return false;
+            items[h & mask] = item;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        //Consumer only. Copies up to `max` items into `out` and returns how many were copied.
+        size_t pop_batch(T *out, size_t max)
+        {
+            size_t t = tail.load(std::memory_order_relaxed);
+            size_t available = head.load(std::memory_order_acquire) - t;
+            size_t count = available < max ? available : max;
+            for (size_t i = 0; i < count; i++)
+                out[i] = items[(t + i) & mask];
+            tail.store(t + count, std::memory_order_release);
+            return count;
+        }
+
+        //Approximate when called concurrently with push()/pop_batch()
+        size_t size() const
+        {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        static constexpr size_t capacity()
+        {
+            return N;
+        }
+};
+
+#endif
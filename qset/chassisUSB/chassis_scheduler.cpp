@@ -0,0 +1,202 @@
+#include "chassis_scheduler.h"
+#include "chassis_clock.h"
+#include <cerrno>
+#include <future>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+static constexpr int64_t ns_per_sec = 1000000000;
+
+static void sleep_until_ns(int64_t deadline_ns)
+{
+    timespec ts;
+    ts.tv_sec = deadline_ns / ns_per_sec;
+    ts.tv_nsec = deadline_ns % ns_per_sec;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        ;
+}
+
+int CBLoopStats::percentile_us(const uint64_t (&hist)[CB_LOOP_HIST_BUCKETS], double pct)
+{
+    uint64_t total = 0;
+    for (uint64_t count : hist)
+        total += count;
+    if (total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(total * pct / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < CB_LOOP_HIST_BUCKETS; i++)
+    {
+        seen += hist[i];
+        if (seen > rank)
+            return i;
+    }
+    return CB_LOOP_HIST_BUCKETS - 1;
+}
+
+ChassisLoopScheduler::ChassisLoopScheduler(double rate_hz)
+{
+    period_ns = rate_hz > 0 ? (int64_t)(ns_per_sec / rate_hz) : 0;
+}
+
+ChassisLoopScheduler::~ChassisLoopScheduler()
+{
+    stop();
+}
+
+void ChassisLoopScheduler::set_realtime(int priority)
+{
+    rt_priority = priority;
+}
+
+void ChassisLoopScheduler::set_cpu(int cpu)
+{
+    this->cpu = cpu;
+}
+
+int ChassisLoopScheduler::start(CBLoopCallback callback)
+{
+    if (loop_thread.joinable())
+        return EBUSY;
+    if (period_ns <= 0 || !callback)
+        return EINVAL;
+    this->callback = std::move(callback);
+    running = true;
+
+    //The policy is applied from inside the thread, the result is handed back before the first cycle
+    std::promise<int> started;
+    std::future<int> result = started.get_future();
+    loop_thread = std::thread([this, &started]() {
+        int err = apply_thread_policy();
+        started.set_value(err);
+        if (err == 0)
+            loop();
+    });
+    int err = result.get();
+    if (err != 0)
+    {
+        loop_thread.join();
+        running = false;
+    }
+    return err;
+}
+
+void ChassisLoopScheduler::stop()
+{
+    running = false;
+    if (loop_thread.joinable())
+        loop_thread.join();
+}
+
+bool ChassisLoopScheduler::is_running() const
+{
+    return running;
+}
+
+int64_t ChassisLoopScheduler::get_period_ns() const
+{
+    return period_ns;
+}
+
+int ChassisLoopScheduler::apply_thread_policy()
+{
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0)
+            return err;
+    }
+    if (rt_priority > 0)
+    {
+        sched_param param = {};
+        param.sched_priority = rt_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0)
+            return err;
+    }
+    return 0;
+}
+
+void ChassisLoopScheduler::record(std::atomic<uint64_t> (&hist)[CB_LOOP_HIST_BUCKETS], std::atomic<int64_t> &max, int64_t value_ns)
+{
+    if (value_ns < 0)
+        value_ns = -value_ns;
+    int64_t bucket = value_ns / 1000;
+    if (bucket >= CB_LOOP_HIST_BUCKETS)
+        bucket = CB_LOOP_HIST_BUCKETS - 1;
+    //Single writer, a plain load/store is enough and keeps the hot path free of locked instructions
+    hist[bucket].store(hist[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value_ns > max.load(std::memory_order_relaxed))
+        max.store(value_ns, std::memory_order_relaxed);
+}
+
+void ChassisLoopScheduler::loop()
+{
+    int64_t deadline = (int64_t)cb_now_ns() + period_ns;
+    int64_t last_wake = 0;
+    uint64_t cycle = 0;
+    while (running)
+    {
+        sleep_until_ns(deadline);
+        int64_t wake = (int64_t)cb_now_ns();
+        record(latency_hist, max_latency_ns, wake - deadline);
+        if (last_wake != 0)
+            record(jitter_hist, max_jitter_ns, (wake - last_wake) - period_ns);
+        last_wake = wake;
+
+        callback(cycle++);
+
+        int64_t done = (int64_t)cb_now_ns();
+        int64_t exec = done - wake;
+        if (exec > max_exec_ns.load(std::memory_order_relaxed))
+            max_exec_ns.store(exec, std::memory_order_relaxed);
+        cycles.store(cycle, std::memory_order_relaxed);
+
+        deadline += period_ns;
+        if (done > deadline)
+        {
+            //Resynchronise on the next deadline still in the future
+            int64_t missed = (done - deadline) / period_ns + 1;
+            deadline += missed * period_ns;
+            overruns.store(overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            skipped.store(skipped.load(std::memory_order_relaxed) + missed, std::memory_order_relaxed);
+            last_wake = 0; //The next period is not comparable
+        }
+    }
+}
+
+CBLoopStats ChassisLoopScheduler::get_stats() const
+{
+    CBLoopStats stats;
+    stats.cycles = cycles.load(std::memory_order_relaxed);
+    stats.overruns = overruns.load(std::memory_order_relaxed);
+    stats.skipped = skipped.load(std::memory_order_relaxed);
+    stats.max_latency_ns = max_latency_ns.load(std::memory_order_relaxed);
+    stats.max_jitter_ns = max_jitter_ns.load(std::memory_order_relaxed);
+    stats.max_exec_ns = max_exec_ns.load(std::memory_order_relaxed);
+    for (int i = 0; i < CB_LOOP_HIST_BUCKETS; i++)
+    {
+        stats.latency_hist[i] = latency_hist[i].load(std::memory_order_relaxed);
+        stats.jitter_hist[i] = jitter_hist[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void ChassisLoopScheduler::reset_stats()
+{
+    cycles = 0;
+    overruns = 0;
+    skipped = 0;
+    max_latency_ns = 0;
+    max_jitter_ns = 0;
+    max_exec_ns = 0;
+    for (int i = 0; i < CB_LOOP_HIST_BUCKETS; i++)
+    {
+        latency_hist[i] = 0;
+        jitter_hist[i] = 0;
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef CHASSIS_SCHEDULER_H
+#define CHASSIS_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+/**
+ * @file chassis_scheduler.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Fixed Rate Control Loop Scheduler
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Histogram resolution: one bucket per microsecond, the last bucket collects everything above
+static constexpr int CB_LOOP_HIST_BUCKETS = 1001;
+
+//Snapshot of the loop timing statistics
+struct CBLoopStats
+{
+    uint64_t cycles;
+    //Cycles whose callback ran past the next deadline (the missed periods are skipped)
+    uint64_t overruns;
+    //Periods skipped because of overruns
+    uint64_t skipped;
+    //Worst wake up latency (time between deadline and actual wake up) in ns
+    int64_t max_latency_ns;
+    //Worst deviation of the measured period from the nominal period in ns
+    int64_t max_jitter_ns;
+    //Worst callback execution time in ns
+    int64_t max_exec_ns;
+    uint64_t latency_hist[CB_LOOP_HIST_BUCKETS]; //Wake up latency, 1 us per bucket
+    uint64_t jitter_hist[CB_LOOP_HIST_BUCKETS];  //Period jitter, 1 us per bucket
+
+    //Returns the percentile (0 to 100) of a histogram in microseconds (`CB_LOOP_HIST_BUCKETS - 1` = overflow)
+    static int percentile_us(const uint64_t (&hist)[CB_LOOP_HIST_BUCKETS], double pct);
+};
+
+/**
+ * @class ChassisLoopScheduler
+ * @brief Runs a callback at a fixed rate on its own thread, e.g. around `DrvMtr.write()`/`read()`.
+ *
+ * Deadlines are absolute (`clock_nanosleep` with `TIMER_ABSTIME` on `CLOCK_MONOTONIC`), so the
+ * loop does not drift no matter how long each cycle takes. Optionally the thread is switched to
+ * `SCHED_FIFO` and pinned to a CPU. Every cycle records its wake up latency, period jitter and
+ * execution time so the loop can be shown to hold its rate under load.
+ *
+ * When a callback runs past the next deadline the cycle counts as an overrun and the loop
+ * resynchronises on the next future deadline instead of firing the missed cycles back to back.
+ */
+class ChassisLoopScheduler
+{
+    public:
+        //Called once per cycle with the cycle number (starting at 0)
+        using CBLoopCallback = std::function<void(uint64_t cycle)>;
+
+        explicit ChassisLoopScheduler(double rate_hz);
+        ChassisLoopScheduler(const ChassisLoopScheduler&) = delete;
+        ChassisLoopScheduler& operator=(const ChassisLoopScheduler&) = delete;
+        ~ChassisLoopScheduler();
+
+        /**
+         * @brief Requests `SCHED_FIFO` for the loop thread. Must be called before `start()`.
+         *
+         * @param priority FIFO priority (1 to 99), 0 keeps the default scheduling policy.
+         */
+        void set_realtime(int priority);
+
+        //Pins the loop thread to a CPU (-1 = no pinning). Must be called before `start()`.
+        void set_cpu(int cpu);
+
+        /**
+         * @brief Starts the loop thread. The first cycle runs one period after the call.
+         *
+         * @return 0 on success, `EBUSY` if already running, `EINVAL` for a non-positive rate,
+         *         or the errno reported while applying the realtime policy or CPU affinity
+         *         (e.g. `EPERM` without `CAP_SYS_NICE`). The loop is not running on error.
+         */
+        int start(CBLoopCallback callback);
+
+        //Stops the loop after the current cycle and joins the thread
+        void stop();
+
+        bool is_running() const;
+        int64_t get_period_ns() const;
+        CBLoopStats get_stats() const;
+        //Clears the statistics, only reliable while the loop is stopped
+        void reset_stats();
+
+    private:
+        int64_t period_ns;
+        int rt_priority = 0;
+        int cpu = -1;
+        CBLoopCallback callback;
+        std::atomic<bool> running{false};
+        std::thread loop_thread;
+
+        //Written by the loop thread only, read by get_stats()
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> overruns{0};
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<int64_t> max_latency_ns{0};
+        std::atomic<int64_t> max_jitter_ns{0};
+        std::atomic<int64_t> max_exec_ns{0};
+        std::atomic<uint64_t> latency_hist[CB_LOOP_HIST_BUCKETS] = {};
+        std::atomic<uint64_t> jitter_hist[CB_LOOP_HIST_BUCKETS] = {};
+
+        int apply_thread_policy();
+        void loop();
+        static void record(std::atomic<uint64_t> (&hist)[CB_LOOP_HIST_BUCKETS], std::atomic<int64_t> &max, int64_t value_ns);
+};
+
+#endif
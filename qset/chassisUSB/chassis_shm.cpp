@@ -0,0 +1,101 @@
+#include "chassis_shm.h"
+#include "chassis_clock.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ChassisShmClient::~ChassisShmClient()
+{
+    close();
+}
+
+int ChassisShmClient::open(const char *name)
+{
+    if (is_open())
+        return EBUSY;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return errno;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CBShmSegment))
+    {
+        ::close(fd);
+        return EPROTO;
+    }
+    void *map = mmap(nullptr, sizeof(CBShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); //The mapping stays valid
+    if (map == MAP_FAILED)
+        return errno;
+    CBShmSegment *mapped = static_cast<CBShmSegment*>(map);
+    if (mapped->magic.load(std::memory_order_acquire) != cb_shm_magic || mapped->version != cb_shm_version || mapped->size != sizeof(CBShmSegment))
+    {
+        munmap(map, sizeof(CBShmSegment));
+        return EPROTO;
+    }
+    segment = mapped;
+    return 0;
+}
+
+void ChassisShmClient::close()
+{
+    if (segment)
+        munmap(segment, sizeof(CBShmSegment));
+    segment = nullptr;
+}
+
+bool ChassisShmClient::is_open() const
+{
+    return segment != nullptr;
+}
+
+bool ChassisShmClient::read(udev_pkt_drvm_sts &packet, uint64_t *timestamp_ns) const
+{
+    return segment && segment->drive.read(packet, timestamp_ns, nullptr);
+}
+
+bool ChassisShmClient::read(udev_pkt_srvo_sts &packet, uint64_t *timestamp_ns) const
+{
+    return segment && segment->servo.read(packet, timestamp_ns, nullptr);
+}
+
+bool ChassisShmClient::read(udev_pkt_sens_sts &packet, uint64_t *timestamp_ns) const
+{
+    return segment && segment->sensors.read(packet, timestamp_ns, nullptr);
+}
+
+bool ChassisShmClient::post(const udev_pkt_drvm_ctrl &packet)
+{
+    if (!segment)
+        return false;
+    CBShmCommand command;
+    command.kind = eCBShmDrive;
+    command.drive = packet;
+    if (segment->push(command))
+        return true;
+    segment->commands_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool ChassisShmClient::post(const udev_pkt_srvo_ctrl &packet)
+{
+    if (!segment)
+        return false;
+    CBShmCommand command;
+    command.kind = eCBShmServo;
+    command.servo = packet;
+    if (segment->push(command))
+        return true;
+    segment->commands_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool ChassisShmClient::is_alive(uint64_t max_age_ns) const
+{
+    if (!segment)
+        return false;
+    uint64_t beat = segment->heartbeat_ns.load(std::memory_order_relaxed);
+    uint64_t now = cb_now_ns();
+    return beat != 0 && (now < beat || now - beat <= max_age_ns);
+}
@@ -0,0 +1,230 @@
+#ifndef CHASSIS_SHM_H
+#define CHASSIS_SHM_H
+
+#include "dependencies/usb_packet.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @file chassis_shm.h
+ * @author Kian Cossettini
+ * @brief Shared-memory segment of the chassis daemon and its client
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Default POSIX shared-memory name of the chassis daemon
+static constexpr const char *cb_shm_default_name = "/qset_chassis";
+static constexpr uint32_t cb_shm_magic = 0x54455351; //"QSET"
+static constexpr uint32_t cb_shm_version = 1;
+//Commands the queue holds before `post()` fails, power of two
+static constexpr uint32_t cb_shm_queue_size = 256;
+//Attempts of a status read racing the daemon before it gives up (a daemon killed while publishing
+//leaves the sequence number odd forever)
+static constexpr int cb_shm_read_retries = 10000;
+//A segment whose heartbeat is older than this is left from a dead daemon and may be replaced
+static constexpr uint64_t cb_shm_stale_ns = 1000000000;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory atomics must be lock free");
+
+/**
+ * @brief Latest status packet of one interface, guarded by a sequence lock.
+ *
+ * Only the daemon writes. Readers never block the writer: they copy the packet and retry if the
+ * sequence number changed meanwhile (odd while a write is in progress).
+ */
+template <typename Packet>
+struct alignas(64) CBShmStatus
+{
+    std::atomic<uint64_t> seq;
+    uint64_t timestamp_ns; //Host `CLOCK_MONOTONIC` time the packet arrived
+    uint64_t count;        //Packets published so far
+    Packet packet;
+
+    //Daemon only
+    void publish(const Packet &value, uint64_t time_ns)
+    {
+        uint64_t start = seq.load(std::memory_order_relaxed);
+        seq.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&packet, &value, sizeof(Packet));
+        timestamp_ns = time_ns;
+        count++;
+        seq.store(start + 2, std::memory_order_release);
+    }
+
+    //Any process. Returns false if nothing has been published yet, or no consistent copy was
+    //obtained within `cb_shm_read_retries` attempts.
+    bool read(Packet &out, uint64_t *time_ns, uint64_t *published) const
+    {
+        for (int attempt = 0; attempt < cb_shm_read_retries; attempt++)
+        {
+            uint64_t start = seq.load(std::memory_order_acquire);
+            if (start & 1)
+                continue;
+            memcpy(&out, &packet, sizeof(Packet));
+            uint64_t stamp = timestamp_ns;
+            uint64_t total = count;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) != start)
+                continue;
+            if (time_ns)
+                *time_ns = stamp;
+            if (published)
+                *published = total;
+            return total > 0;
+        }
+        return false;
+    }
+};
+
+enum eCBShmCommand : uint8_t
+{
+    eCBShmDrive,
+    eCBShmServo
+};
+
+//Command passed from a client to the daemon
+struct CBShmCommand
+{
+    uint8_t kind; //eCBShmCommand
+    union
+    {
+        udev_pkt_drvm_ctrl drive;
+        udev_pkt_srvo_ctrl servo;
+    };
+};
+
+/**
+ * @brief Layout of the shared-memory segment.
+ *
+ * Commands travel through a bounded lock-free queue (any number of client processes push, the daemon
+ * pops). Every cell carries a sequence number telling producers and the consumer whose turn it is.
+ */
+struct CBShmSegment
+{
+    std::atomic<uint32_t> magic; //Written last by the daemon, the segment is usable once it matches
+    uint32_t version;
+    uint32_t size;               //sizeof(CBShmSegment) of the daemon
+    std::atomic<uint64_t> heartbeat_ns; //Refreshed every daemon cycle
+    std::atomic<uint64_t> commands_dropped; //Posts rejected because the queue was full
+    CBShmStatus<udev_pkt_drvm_sts> drive;
+    CBShmStatus<udev_pkt_srvo_sts> servo;
+    CBShmStatus<udev_pkt_sens_sts> sensors;
+
+    struct alignas(64) CBShmCell
+    {
+        std::atomic<uint64_t> seq;
+        CBShmCommand command;
+    };
+    alignas(64) std::atomic<uint64_t> enqueue_pos;
+    alignas(64) std::atomic<uint64_t> dequeue_pos;
+    CBShmCell cells[cb_shm_queue_size];
+
+    //Daemon only, on a fresh segment
+    void init_queue()
+    {
+        for (uint32_t i = 0; i < cb_shm_queue_size; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    //Any process. Returns false if the queue is full.
+    bool push(const CBShmCommand &command)
+    {
+        uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            CBShmCell &cell = cells[pos & (cb_shm_queue_size - 1)];
+            uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            if (seq == pos)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.command = command;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (seq < pos)
+                return false;
+            else
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    //Daemon only. Returns false if the queue is empty.
+    bool pop(CBShmCommand &command)
+    {
+        uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        CBShmCell &cell = cells[pos & (cb_shm_queue_size - 1)];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+            return false;
+        command = cell.command;
+        cell.seq.store(pos + cb_shm_queue_size, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+static_assert(std::is_trivially_copyable<CBShmCommand>::value, "Shared-memory commands must be trivially copyable");
+
+/**
+ * @class ChassisShmClient
+ * @brief Reads chassis state from and sends commands to a running `ChassisDaemon`.
+ *
+ * Reads are a copy out of the mapped segment (no system call, no lock), so any local process gets
+ * the latest drive, servo and sensor status in well under a microsecond.
+ *
+ * @code
+ * ChassisShmClient chassis;
+ * if (chassis.open() == 0)
+ * {
+ *     udev_pkt_sens_sts sensors;
+ *     if (chassis.read(sensors))
+ *         use(sensors.adc_volts[eDrvADC1]);
+ * }
+ * @endcode
+ */
+class ChassisShmClient
+{
+    public:
+        ChassisShmClient() = default;
+        ChassisShmClient(const ChassisShmClient&) = delete;
+        ChassisShmClient& operator=(const ChassisShmClient&) = delete;
+        ~ChassisShmClient();
+
+        /**
+         * @brief Maps the segment of the daemon.
+         *
+         * @return 0 on success, `ENOENT` if no daemon has created it, `EPROTO` if the segment is not
+         *         initialized or was created by an incompatible version, otherwise an errno value.
+         */
+        int open(const char *name = cb_shm_default_name);
+        void close();
+        bool is_open() const;
+
+        //Latest status, false if none has been published yet. `timestamp_ns` may be nullptr.
+        bool read(udev_pkt_drvm_sts &packet, uint64_t *timestamp_ns = nullptr) const;
+        bool read(udev_pkt_srvo_sts &packet, uint64_t *timestamp_ns = nullptr) const;
+        bool read(udev_pkt_sens_sts &packet, uint64_t *timestamp_ns = nullptr) const;
+
+        //Queues a command for the daemon, which posts it to the board's command mailboxes. False if the queue is full.
+        bool post(const udev_pkt_drvm_ctrl &packet);
+        bool post(const udev_pkt_srvo_ctrl &packet);
+
+        //Whether the daemon refreshed its heartbeat within `max_age_ns`
+        bool is_alive(uint64_t max_age_ns = 100000000) const;
+
+    private:
+        CBShmSegment *segment = nullptr;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "chassis_trajectory.h"
+#include <cerrno>
+#include <cmath>
+
+//Position on segment [i, i + 1] at fraction s (0 to 1) of the segment
+static double interpolate(eCBTrajProfile profile, const std::vector<double> &points, const std::vector<double> &times,
+                          const std::vector<double> &slopes, size_t i, double s)
+{
+    double p0 = points[i], p1 = points[i + 1];
+    switch (profile)
+    {
+        case eCBTrajCubic:
+        {
+            //Cubic Hermite basis with the spline slopes scaled to the segment length
+            double h = times[i + 1] - times[i];
+            double s2 = s * s, s3 = s2 * s;
+            return (2 * s3 - 3 * s2 + 1) * p0 + (s3 - 2 * s2 + s) * h * slopes[i]
+                 + (-2 * s3 + 3 * s2) * p1 + (s3 - s2) * h * slopes[i + 1];
+        }
+        case eCBTrajMinJerk:
+        {
+            double s3 = s * s * s;
+            return p0 + (p1 - p0) * s3 * (10 - 15 * s + 6 * s * s);
+        }
+        default:
+            return p0 + (p1 - p0) * s;
+    }
+}
+
+int ChassisServoTrajectory::build(eChassisServo servo, uint32_t start_ctrl, const std::vector<CBServoWaypoint> &waypoints,
+                                  eCBTrajProfile profile, double rate_hz)
+{
+    if (servo < 0 || servo >= eN_Servo || waypoints.empty() || !(rate_hz > 0))
+        return EINVAL;
+
+    //Knots: the start plus every waypoint, at their absolute times
+    std::vector<double> points(1, start_ctrl), times(1, 0.0);
+    for (const CBServoWaypoint &waypoint : waypoints)
+    {
+        if (!(waypoint.duration_s >= 0))
+            return EINVAL;
+        points.push_back(waypoint.ctrl);
+        times.push_back(times.back() + waypoint.duration_s);
+    }
+    double total = times.back();
+    if (total * rate_hz + 1 > max_setpoints)
+        return EINVAL;
+
+    //Spline slopes: central differences inside, at rest on both ends
+    std::vector<double> slopes(points.size(), 0.0);
+    for (size_t i = 1; i + 1 < points.size(); i++)
+    {
+        double span = times[i + 1] - times[i - 1];
+        slopes[i] = span > 0 ? (points[i + 1] - points[i - 1]) / span : 0.0;
+    }
+
+    size_t count = (size_t)std::ceil(total * rate_hz - 1e-9) + 1;
+    std::vector<uint32_t> result(count);
+    size_t segment = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        double t = std::fmin(k / rate_hz, total);
+        while (segment + 2 < times.size() && t >= times[segment + 1])
+            segment++;
+        double length = times[segment + 1] - times[segment];
+        double s = length > 0 ? std::fmin((t - times[segment]) / length, 1.0) : 1.0;
+        double value = std::round(interpolate(profile, points, times, slopes, segment, s));
+        result[k] = (uint32_t)std::fmin(std::fmax(value, 0.0), (double)UINT32_MAX);
+    }
+    result.back() = waypoints.back().ctrl; //Lands exactly on the last waypoint
+
+    this->servo = servo;
+    this->rate_hz = rate_hz;
+    setpoints.swap(result);
+    return 0;
+}
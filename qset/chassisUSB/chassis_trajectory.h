@@ -0,0 +1,74 @@
+#ifndef CHASSIS_TRAJECTORY_H
+#define CHASSIS_TRAJECTORY_H
+
+#include "dependencies/usb_chassis_defs.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file chassis_trajectory.h
+ * @author Kian Cossettini
+ * @brief Precomputed servo trajectories
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Interpolation between waypoints
+enum eCBTrajProfile
+{
+    eCBTrajLinear, //Constant speed, velocity jumps at every waypoint
+    eCBTrajCubic,  //Cubic spline through the waypoints, continuous velocity, starts and ends at rest
+    eCBTrajMinJerk //Minimum jerk per segment, comes to rest at every waypoint
+};
+
+//Servo target `ctrl` (the `srvo_ctrl` value) reached `duration_s` after the previous waypoint
+struct CBServoWaypoint
+{
+    uint32_t ctrl;
+    double duration_s;
+};
+
+/**
+ * @class ChassisServoTrajectory
+ * @brief Interpolated `srvo_ctrl` setpoints of one servo, sampled at a fixed rate.
+ *
+ * All setpoints are computed once by `build()`, playing the trajectory (`servos.play()`) then only
+ * sends the precomputed values at the trajectory rate from the board's player thread.
+ */
+class ChassisServoTrajectory
+{
+    public:
+        //Longest trajectory in setpoints
+        static constexpr size_t max_setpoints = 1 << 22;
+
+        /**
+         * @brief Computes the setpoints from `start_ctrl` through every waypoint.
+         *
+         * @param servo Servo the trajectory is played on.
+         * @param start_ctrl Position at the start, usually the last command sent to the servo.
+         * @param waypoints Targets in order, each with the time to reach it from the previous one.
+         * @param rate_hz Setpoints per second, i.e. the rate the trajectory is streamed at.
+         *
+         * @return 0 on success, `EINVAL` for an unknown servo, no waypoints, a negative duration, a
+         *         non-positive rate or more than `max_setpoints` setpoints.
+         */
+        int build(eChassisServo servo, uint32_t start_ctrl, const std::vector<CBServoWaypoint> &waypoints,
+                  eCBTrajProfile profile, double rate_hz);
+
+        eChassisServo get_servo() const { return servo; }
+        double get_rate() const { return rate_hz; }
+        double get_duration() const { return setpoints.empty() ? 0.0 : (setpoints.size() - 1) / rate_hz; }
+        //Setpoint i is sent i / rate seconds after the start
+        const std::vector<uint32_t> &get_setpoints() const { return setpoints; }
+
+    private:
+        eChassisServo servo = eN_Servo;
+        double rate_hz = 0;
+        std::vector<uint32_t> setpoints;
+};
+
+#endif
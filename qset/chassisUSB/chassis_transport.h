@@ -0,0 +1,171 @@
+#ifndef CHASSIS_TRANSPORT_H
+#define CHASSIS_TRANSPORT_H
+
+#include <libusb-1.0/libusb.h>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+/**
+ * @file chassis_transport.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Board Transport Interface
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+struct CBTransportRequest;
+
+/**
+ * @brief Completion function of an asynchronous request.
+ *
+ * Called by `ChassisTransport::handle_events()` on the event thread.
+ *
+ * @param request The completed request.
+ * @param err `LIBUSB_SUCCESS` or the libusb error of the transfer (`LIBUSB_ERROR_INTERRUPTED` when cancelled).
+ * @param actual_length Number of bytes transferred.
+ */
+using CBRequestComplete = void (*)(CBTransportRequest *request, libusb_error err, int actual_length);
+
+//Asynchronous request, owned by the caller and reused between submissions
+struct CBTransportRequest
+{
+    uint8_t endpoint = 0;
+    uint8_t type = LIBUSB_TRANSFER_TYPE_BULK; //LIBUSB_TRANSFER_TYPE_BULK or LIBUSB_TRANSFER_TYPE_INTERRUPT
+    unsigned char *buffer = nullptr;
+    int length = 0;
+    unsigned int timeout = 0; //ms, 0 = no timeout
+    CBRequestComplete on_complete = nullptr;
+    void *user_data = nullptr;
+    void *backend = nullptr; //Backend private state, set up by `prepare()`
+};
+
+//Memory backing the transfer buffers of the asynchronous engine
+struct CBBufferBlock
+{
+    unsigned char *data = nullptr;
+    size_t size = 0;
+    void *backend = nullptr; //Set when the backend provided the memory (e.g. device memory)
+};
+
+//Link state of a transport, see `ChassisTransport::get_link_stats()`
+struct CBLinkStats
+{
+    bool connected = true;
+    uint32_t disconnects = 0;
+    uint32_t reconnects = 0;
+    uint64_t last_outage_ns = 0;    //Board lost to interfaces claimed again, last reconnect
+    uint64_t max_outage_ns = 0;
+    uint64_t last_reconnect_ns = 0; //Board enumerated to interfaces claimed again, last reconnect
+};
+
+//Steps from `ChassisBoard::initialize()` to the claimed interfaces, see `ChassisTransport::get_startup_stats()`
+enum eCBStartupPhase
+{
+    eCBPhaseInit,        //libusb context and options
+    eCBPhaseFind,        //Locating the board
+    eCBPhaseOpen,        //Opening the device
+    eCBPhaseClaimDrive,  //Detaching the kernel driver (if allowed) and claiming each data interface
+    eCBPhaseClaimServo,
+    eCBPhaseClaimSensor,
+    eN_StartupPhase
+};
+
+struct CBStartupStats
+{
+    uint64_t phase_ns[eN_StartupPhase] = {};
+    uint64_t total_ns = 0;            //`initialize()` called to the last interface claimed
+    libusb_error err = LIBUSB_SUCCESS;
+    eCBStartupPhase failed = eN_StartupPhase; //Phase that returned `err`, `eN_StartupPhase` if none failed
+    bool path_hit = false;            //Found at the cached bus path without a VID/PID search
+    std::string bus_path;             //Where the board was found, pass it to the next start
+};
+
+/**
+ * @brief Called when the transport loses the board (`false`) and once it is usable again (`true`).
+ *
+ * Not called from the event thread, so the handler may submit transfers.
+ */
+using CBLinkHandler = std::function<void(bool connected)>;
+
+/**
+ * @class ChassisTransport
+ * @brief Moves chassis packets between the host and a board.
+ *
+ * `ChassisBoard` performs all of its I/O through this interface. `ChassisLibusbTransport` talks to
+ * the real board, `ChassisMockBoard` simulates one in-process so control code can be tested and
+ * benchmarked without hardware. All functions report errors as libusb error codes.
+ */
+class ChassisTransport
+{
+    public:
+        virtual ~ChassisTransport() = default;
+
+        //Locates the board and prepares the transport (`ChassisBoard::initialize()`)
+        virtual libusb_error open(libusb_log_level log_lvl) = 0;
+
+        //Claims the data interfaces (`ChassisBoard::claimInterfaces()`)
+        virtual libusb_error claim_interfaces() = 0;
+
+        //Claims one additional interface, e.g. a notification interface
+        virtual libusb_error claim_interface(int interface_num) = 0;
+        virtual void release_interface(int interface_num) = 0;
+
+        //Blocking transfer, bulk or interrupt depending on the endpoint
+        virtual libusb_error transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) = 0;
+
+        //Sets up the backend state of a request once, before its first submission
+        virtual libusb_error prepare(CBTransportRequest *request) = 0;
+        //Frees the backend state of a request that is no longer in flight
+        virtual void release(CBTransportRequest *request) = 0;
+
+        //Starts an asynchronous request, `on_complete` is called from `handle_events()`
+        virtual libusb_error submit(CBTransportRequest *request) = 0;
+        //Cancels an in-flight request, it completes with `LIBUSB_ERROR_INTERRUPTED`
+        virtual void cancel(CBTransportRequest *request) = 0;
+        //Completes a request that is not in flight with `err` during the next `handle_events()`, so failures
+        //found on other threads are still reported on the event thread
+        virtual void complete_later(CBTransportRequest *request, libusb_error err) = 0;
+
+        //Waits up to `timeout_us` for completions and runs their callbacks
+        virtual void handle_events(int timeout_us) = 0;
+        //Makes a concurrent `handle_events()` return early
+        virtual void wake() = 0;
+
+        //True when an outside loop (`ChassisBoardManager`) handles the events, users must not call `handle_events()`
+        virtual bool shared_events() const { return false; }
+
+        /**
+         * @brief Allocates `size` bytes of cache line aligned transfer buffer memory.
+         *
+         * With `device_memory`, backends that support it return memory the kernel transfers without
+         * copying, all others (and backends on failure) fall back to regular aligned memory.
+         */
+        virtual CBBufferBlock alloc_buffers(size_t size, bool device_memory)
+        {
+            (void)device_memory;
+            CBBufferBlock block;
+            size = (size + 63) & ~(size_t)63;
+            block.data = static_cast<unsigned char*>(std::aligned_alloc(64, size));
+            block.size = block.data ? size : 0;
+            return block;
+        }
+        virtual void free_buffers(CBBufferBlock &block)
+        {
+            std::free(block.data);
+            block = CBBufferBlock();
+        }
+
+        //Transports that reconnect on their own report link changes here, the others are always connected
+        virtual void set_link_handler(CBLinkHandler handler) { (void)handler; }
+        virtual CBLinkStats get_link_stats() { return CBLinkStats(); }
+
+        //Per phase timing and failure of the last `open()` / `claim_interfaces()`, empty for in-process transports
+        virtual CBStartupStats get_startup_stats() { return CBStartupStats(); }
+};
+
+#endif
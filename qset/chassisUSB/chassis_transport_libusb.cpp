@@ -0,0 +1,655 @@
+#include "chassis_transport_libusb.h"
+#include "chassis_clock.h"
+#include <algorithm>
+#include <chrono>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+//Returns whether the kernel driver of an interface may be detached (see the `CHASSIS_KDBYPASS_*` flags)
+static bool detach_allowed(int interface_num)
+{
+    switch (interface_num)
+    {
+        case DRVM_NTF_INUM:
+        case DRVM_DATA_INUM:
+            #ifdef CHASSIS_KDBYPASS_DRVMTR
+            return false;
+            #else
+            return true;
+            #endif
+        //The servo and sensor share their interfaces, bypassing either bypasses both
+        case SRVO_NTF_INUM:
+        case SRVO_DATA_INUM:
+            #if defined(CHASSIS_KDBYPASS_SERVO) || defined(CHASSIS_KDBYPASS_SENSOR)
+            return false;
+            #else
+            return true;
+            #endif
+        default:
+            return true;
+    }
+}
+
+//Detaches the kernel driver if allowed and claims the interface
+static libusb_error claim_on(libusb_device_handle *handle, int interface_num)
+{
+    int err = 0;
+    //Where supported libusb detaches and claims in one request (usbfs `DISCONNECT_CLAIM`),
+    //switched off again right away so releasing does not reattach the kernel driver
+    if (detach_allowed(interface_num) && libusb_set_auto_detach_kernel_driver(handle, 1) == LIBUSB_SUCCESS)
+    {
+        err = libusb_claim_interface(handle, interface_num);
+        libusb_set_auto_detach_kernel_driver(handle, 0);
+        return (libusb_error)err;
+    }
+    if (detach_allowed(interface_num) && libusb_kernel_driver_active(handle, interface_num) == 1)
+    {
+        err = libusb_detach_kernel_driver(handle, interface_num);
+        if (err < LIBUSB_SUCCESS)
+            return (libusb_error)err;
+    }
+    return (libusb_error)libusb_claim_interface(handle, interface_num);
+}
+
+//Backend state of a request, the owner is needed by the completion callback
+struct CBLibusbRequest
+{
+    libusb_transfer *transfer;
+    ChassisLibusbTransport *owner;
+};
+
+ChassisLibusbTransport::HandleRef::HandleRef(ChassisLibusbTransport &owner) : owner(owner)
+{
+    owner.handle_users++;
+    handle = owner.handle.load();
+}
+
+ChassisLibusbTransport::HandleRef::~HandleRef()
+{
+    owner.handle_users--;
+}
+
+ChassisLibusbTransport::ChassisLibusbTransport(const std::string &bus_path) : path(bus_path)
+{
+}
+
+ChassisLibusbTransport::ChassisLibusbTransport(libusb_context *context, libusb_device *device, const std::string &serial,
+                                               CBPostedCompletions *posted)
+{
+    this->posted = posted;
+    ctx = context;
+    shared_ctx = true;
+    this->device = libusb_ref_device(device);
+    device_ref = true;
+    this->serial = serial;
+    path = bus_path(device);
+}
+
+ChassisLibusbTransport::~ChassisLibusbTransport()
+{
+    if (hotplug_registered)
+        libusb_hotplug_deregister_callback(ctx, hotplug_handle);
+    {
+        std::lock_guard<std::mutex> guard(link_lock);
+        link_stopping = true;
+    }
+    link_cv.notify_all();
+    if (link_thread.joinable())
+        link_thread.join();
+
+    if (handle)
+    {
+        libusb_release_interface(handle, DRVM_DATA_INUM);
+        libusb_release_interface(handle, SRVO_DATA_INUM);
+        libusb_release_interface(handle, SENS_DATA_INUM);
+    }
+    libusb_close(handle);
+    if (device_ref && device)
+        libusb_unref_device(device);
+    if (!shared_ctx && ctx)
+        libusb_exit(ctx);
+}
+
+libusb_error ChassisLibusbTransport::end_phase(eCBStartupPhase phase, uint64_t since, libusb_error err)
+{
+    uint64_t now = cb_now_ns();
+    startup.phase_ns[phase] = now - since;
+    if (err != LIBUSB_SUCCESS)
+    {
+        startup.err = err;
+        startup.failed = phase;
+        startup.total_ns = now - startup_begin_ns;
+    }
+    return err;
+}
+
+libusb_device *ChassisLibusbTransport::find_device(libusb_device **devices, ssize_t count)
+{
+    //The cached path first, without reading the descriptors of the other devices
+    if (!path.empty())
+    {
+        for (ssize_t i = 0; i < count; i++)
+        {
+            if (bus_path(devices[i]) != path)
+                continue;
+            libusb_device_descriptor desc;
+            if (libusb_get_device_descriptor(devices[i], &desc) == LIBUSB_SUCCESS && desc.idVendor == B_VID && desc.idProduct == B_PID)
+            {
+                startup.path_hit = true;
+                return devices[i];
+            }
+            break;
+        }
+    }
+    for (ssize_t i = 0; i < count; i++)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devices[i], &desc) == LIBUSB_SUCCESS && desc.idVendor == B_VID && desc.idProduct == B_PID)
+            return devices[i];
+    }
+    return nullptr;
+}
+
+libusb_error ChassisLibusbTransport::open(libusb_log_level log_lvl)
+{
+    startup = CBStartupStats();
+    startup_begin_ns = cb_now_ns();
+    //The manager already initialized the context and picked the device
+    if (shared_ctx)
+    {
+        startup.bus_path = path;
+        return end_phase(eCBPhaseFind, startup_begin_ns, device ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_DEVICE);
+    }
+
+    int err = 0;
+    uint64_t since = startup_begin_ns;
+    //Initialize LIBUSB context
+    err = libusb_init(&ctx);
+    if (err < LIBUSB_SUCCESS)
+    {
+        ctx = nullptr;
+        return end_phase(eCBPhaseInit, since, (libusb_error)err);
+    }
+
+    //Set debug log level
+    err = libusb_set_option(ctx, LIBUSB_OPTION_LOG_LEVEL, log_lvl);
+    if (err < LIBUSB_SUCCESS)
+        return end_phase(eCBPhaseInit, since, (libusb_error)err);
+    end_phase(eCBPhaseInit, since, LIBUSB_SUCCESS);
+
+    //Find the board, at its cached path if there is one
+    since = cb_now_ns();
+    libusb_device **devices = nullptr;
+    ssize_t count = libusb_get_device_list(ctx, &devices);
+    if (count < LIBUSB_SUCCESS)
+        return end_phase(eCBPhaseFind, since, (libusb_error)count);
+    libusb_device *found = find_device(devices, count);
+    if (found == nullptr)
+    {
+        libusb_free_device_list(devices, 1);
+        return end_phase(eCBPhaseFind, since, LIBUSB_ERROR_NO_DEVICE);
+    }
+    end_phase(eCBPhaseFind, since, LIBUSB_SUCCESS);
+
+    //Open it right away, the open handle keeps the device alive once the list is freed
+    since = cb_now_ns();
+    libusb_device_handle *opened = nullptr;
+    err = libusb_open(found, &opened);
+    libusb_free_device_list(devices, 1);
+    if (err < LIBUSB_SUCCESS)
+        return end_phase(eCBPhaseOpen, since, (libusb_error)err);
+    device = found;
+    handle = opened;
+    startup.bus_path = bus_path(found);
+    //A transport given a path follows the board to the port it was found at
+    if (!path.empty())
+        path = startup.bus_path;
+    return end_phase(eCBPhaseOpen, since, LIBUSB_SUCCESS);
+}
+
+libusb_error ChassisLibusbTransport::claim_interfaces()
+{
+    uint64_t since = cb_now_ns();
+    if (startup_begin_ns == 0)
+        startup_begin_ns = since;
+    //Opened by `open()` unless the device was handed over by the manager
+    if (handle == nullptr)
+    {
+        if (device == nullptr)
+            return end_phase(eCBPhaseOpen, since, LIBUSB_ERROR_NO_DEVICE);
+        libusb_device_handle *opened = nullptr;
+        int err = libusb_open(device, &opened);
+        if (err < LIBUSB_SUCCESS)
+            return end_phase(eCBPhaseOpen, since, (libusb_error)err);
+        handle = opened;
+        end_phase(eCBPhaseOpen, since, LIBUSB_SUCCESS);
+    }
+
+    //Detach (if allowed) and claim the data interfaces, each timed on its own
+    static const int interfaces[] = {DRVM_DATA_INUM, SRVO_DATA_INUM, SENS_DATA_INUM};
+    for (int i = 0; i < 3; i++)
+    {
+        since = cb_now_ns();
+        eCBStartupPhase phase = (eCBStartupPhase)(eCBPhaseClaimDrive + i);
+        if (end_phase(phase, since, claim_on(handle, interfaces[i])) != LIBUSB_SUCCESS)
+            return startup.err;
+    }
+    startup.total_ns = cb_now_ns() - startup_begin_ns;
+
+    start_link_monitor();
+    return LIBUSB_SUCCESS;
+}
+
+CBStartupStats ChassisLibusbTransport::get_startup_stats()
+{
+    return startup;
+}
+
+libusb_error ChassisLibusbTransport::claim_interface(int interface_num)
+{
+    HandleRef ref(*this);
+    if (ref.get() == nullptr)
+        return LIBUSB_ERROR_NO_DEVICE;
+    libusb_error err = claim_on(ref.get(), interface_num);
+    if (err == LIBUSB_SUCCESS)
+    {
+        std::lock_guard<std::mutex> link_guard(link_lock);
+        if (std::find(extra_interfaces.begin(), extra_interfaces.end(), interface_num) == extra_interfaces.end())
+            extra_interfaces.push_back(interface_num);
+    }
+    return err;
+}
+
+void ChassisLibusbTransport::release_interface(int interface_num)
+{
+    {
+        std::lock_guard<std::mutex> link_guard(link_lock);
+        extra_interfaces.erase(std::remove(extra_interfaces.begin(), extra_interfaces.end(), interface_num), extra_interfaces.end());
+    }
+    HandleRef ref(*this);
+    if (ref.get())
+        libusb_release_interface(ref.get(), interface_num);
+}
+
+libusb_error ChassisLibusbTransport::transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout)
+{
+    HandleRef ref(*this);
+    if (ref.get() == nullptr)
+        return LIBUSB_ERROR_NO_DEVICE;
+    int err;
+    if (endpoint == DRVM_NTF_EP || endpoint == SRVO_NTF_EP)
+        err = libusb_interrupt_transfer(ref.get(), endpoint, data, length, transferred, timeout);
+    else
+        err = libusb_bulk_transfer(ref.get(), endpoint, data, length, transferred, timeout);
+    if (err == LIBUSB_ERROR_NO_DEVICE)
+        report_lost();
+    return (libusb_error)err;
+}
+
+libusb_error ChassisLibusbTransport::prepare(CBTransportRequest *request)
+{
+    CBLibusbRequest *backend = new CBLibusbRequest{libusb_alloc_transfer(0), this};
+    if (backend->transfer == nullptr)
+    {
+        delete backend;
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    request->backend = backend;
+    return LIBUSB_SUCCESS;
+}
+
+void ChassisLibusbTransport::release(CBTransportRequest *request)
+{
+    CBLibusbRequest *backend = static_cast<CBLibusbRequest*>(request->backend);
+    if (backend)
+    {
+        libusb_free_transfer(backend->transfer);
+        delete backend;
+    }
+    request->backend = nullptr;
+}
+
+libusb_error ChassisLibusbTransport::submit(CBTransportRequest *request)
+{
+    CBLibusbRequest *backend = static_cast<CBLibusbRequest*>(request->backend);
+    if (backend == nullptr)
+        return LIBUSB_ERROR_INVALID_PARAM;
+    HandleRef ref(*this);
+    if (ref.get() == nullptr)
+        return LIBUSB_ERROR_NO_DEVICE;
+    libusb_transfer *transfer = backend->transfer;
+    if (request->type == LIBUSB_TRANSFER_TYPE_INTERRUPT)
+        libusb_fill_interrupt_transfer(transfer, ref.get(), request->endpoint, request->buffer, request->length, &ChassisLibusbTransport::transfer_cb, request, request->timeout);
+    else
+        libusb_fill_bulk_transfer(transfer, ref.get(), request->endpoint, request->buffer, request->length, &ChassisLibusbTransport::transfer_cb, request, request->timeout);
+    in_flight++;
+    int err = libusb_submit_transfer(transfer);
+    if (err != LIBUSB_SUCCESS)
+    {
+        in_flight--;
+        if (err == LIBUSB_ERROR_NO_DEVICE)
+            report_lost();
+    }
+    return (libusb_error)err;
+}
+
+void ChassisLibusbTransport::cancel(CBTransportRequest *request)
+{
+    CBLibusbRequest *backend = static_cast<CBLibusbRequest*>(request->backend);
+    HandleRef ref(*this);
+    if (backend && ref.get())
+        libusb_cancel_transfer(backend->transfer);
+}
+
+void CBPostedCompletions::post(CBTransportRequest *request, libusb_error err)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.push_back({request, err});
+}
+
+bool CBPostedCompletions::run()
+{
+    std::vector<std::pair<CBTransportRequest*, libusb_error>> ready;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.swap(entries);
+    }
+    //The completions may post again, so they run without the lock
+    for (auto &entry : ready)
+        entry.first->on_complete(entry.first, entry.second, 0);
+    return !ready.empty();
+}
+
+void ChassisLibusbTransport::complete_later(CBTransportRequest *request, libusb_error err)
+{
+    posted->post(request, err);
+    libusb_interrupt_event_handler(ctx);
+}
+
+void ChassisLibusbTransport::handle_events(int timeout_us)
+{
+    if (posted->run())
+        return;
+    timeval tv = {timeout_us / 1000000, timeout_us % 1000000};
+    libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+    posted->run();
+}
+
+void ChassisLibusbTransport::wake()
+{
+    libusb_interrupt_event_handler(ctx);
+}
+
+bool ChassisLibusbTransport::shared_events() const
+{
+    return shared_ctx;
+}
+
+std::string ChassisLibusbTransport::read_serial(libusb_device_handle *handle)
+{
+    libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(libusb_get_device(handle), &desc) != LIBUSB_SUCCESS || desc.iSerialNumber == 0)
+        return std::string();
+    unsigned char text[128];
+    int length = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, text, sizeof(text));
+    return length > 0 ? std::string((const char *)text, length) : std::string();
+}
+
+std::string ChassisLibusbTransport::bus_path(libusb_device *device)
+{
+    uint8_t ports[8];
+    int depth = libusb_get_port_numbers(device, ports, sizeof(ports));
+    std::string result = std::to_string(libusb_get_bus_number(device));
+    for (int i = 0; i < depth; i++)
+        result += (i == 0 ? "-" : ".") + std::to_string(ports[i]);
+    return result;
+}
+
+void LIBUSB_CALL ChassisLibusbTransport::transfer_cb(libusb_transfer *transfer)
+{
+    CBTransportRequest *request = static_cast<CBTransportRequest*>(transfer->user_data);
+    ChassisLibusbTransport *owner = static_cast<CBLibusbRequest*>(request->backend)->owner;
+    libusb_error err = status_to_error(transfer->status);
+    if (err == LIBUSB_ERROR_NO_DEVICE)
+        owner->report_lost();
+    request->on_complete(request, err, transfer->actual_length);
+    //Counted down last, a zero count means no completion is still running
+    owner->in_flight--;
+}
+
+int LIBUSB_CALL ChassisLibusbTransport::hotplug_cb(libusb_context *, libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+    ChassisLibusbTransport *owner = static_cast<ChassisLibusbTransport*>(user_data);
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT)
+    {
+        bool ours;
+        {
+            std::lock_guard<std::mutex> guard(owner->link_lock);
+            ours = dev == owner->device;
+        }
+        if (ours)
+            owner->report_lost();
+    }
+    else
+    {
+        std::lock_guard<std::mutex> guard(owner->link_lock);
+        if (owner->link_lost)
+        {
+            owner->device_arrived = true;
+            if (owner->arrived_ns == 0)
+                owner->arrived_ns = cb_now_ns();
+            owner->link_cv.notify_all();
+        }
+    }
+    return 0; //Stay registered
+}
+
+void ChassisLibusbTransport::start_link_monitor()
+{
+    if (link_thread.joinable())
+        return;
+    if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    {
+        int err = libusb_hotplug_register_callback(ctx, LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+            LIBUSB_HOTPLUG_NO_FLAGS, B_VID, B_PID, LIBUSB_HOTPLUG_MATCH_ANY, &ChassisLibusbTransport::hotplug_cb, this, &hotplug_handle);
+        hotplug_registered = err == LIBUSB_SUCCESS;
+    }
+    link_thread = std::thread(&ChassisLibusbTransport::link_loop, this);
+}
+
+void ChassisLibusbTransport::report_lost()
+{
+    std::lock_guard<std::mutex> guard(link_lock);
+    if (link_lost || !link_thread.joinable())
+        return;
+    link_lost = true;
+    lost_ns = cb_now_ns();
+    arrived_ns = 0;
+    link_stats.connected = false;
+    link_stats.disconnects++;
+    link_cv.notify_all();
+}
+
+libusb_device_handle *ChassisLibusbTransport::reopen()
+{
+    libusb_device **devices = nullptr;
+    ssize_t count = libusb_get_device_list(ctx, &devices);
+    libusb_device_handle *fresh = nullptr;
+    for (ssize_t i = 0; i < count && fresh == nullptr; i++)
+    {
+        libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(devices[i], &desc) != LIBUSB_SUCCESS || desc.idVendor != B_VID || desc.idProduct != B_PID)
+            continue;
+        //With several boards attached only the same one may take over
+        if (!path.empty() && serial.empty() && bus_path(devices[i]) != path)
+            continue;
+        {
+            std::lock_guard<std::mutex> guard(link_lock);
+            if (arrived_ns == 0)
+                arrived_ns = cb_now_ns();
+        }
+        if (libusb_open(devices[i], &fresh) != LIBUSB_SUCCESS)
+            fresh = nullptr;
+        else if (!serial.empty() && read_serial(fresh) != serial)
+        {
+            libusb_close(fresh);
+            fresh = nullptr;
+        }
+    }
+    if (count >= 0)
+        libusb_free_device_list(devices, 1);
+    if (fresh == nullptr)
+        return nullptr;
+
+    std::vector<int> interfaces = {DRVM_DATA_INUM, SRVO_DATA_INUM, SENS_DATA_INUM};
+    {
+        std::lock_guard<std::mutex> guard(link_lock);
+        interfaces.insert(interfaces.end(), extra_interfaces.begin(), extra_interfaces.end());
+    }
+    for (int interface_num : interfaces)
+    {
+        //Usually the board is still enumerating, the next attempt will succeed
+        if (claim_on(fresh, interface_num) != LIBUSB_SUCCESS)
+        {
+            libusb_close(fresh);
+            return nullptr;
+        }
+    }
+    return fresh;
+}
+
+void ChassisLibusbTransport::link_loop()
+{
+    std::unique_lock<std::mutex> guard(link_lock);
+    while (true)
+    {
+        link_cv.wait(guard, [this]() { return link_stopping || link_lost; });
+        if (link_stopping)
+            return;
+        guard.unlock();
+
+        //New calls fail fast from here on
+        libusb_device_handle *dead = handle.exchange(nullptr);
+        {
+            std::lock_guard<std::mutex> handler_guard(handler_lock);
+            if (link_handler)
+                link_handler(false);
+        }
+
+        //Transfers on the dead handle complete with LIBUSB_ERROR_NO_DEVICE on the event thread,
+        //the handle may only be closed once they all have and no call still uses it
+        guard.lock();
+        auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!link_stopping && (in_flight > 0 || handle_users > 0) && std::chrono::steady_clock::now() < give_up)
+            link_cv.wait_for(guard, std::chrono::milliseconds(1));
+        bool can_close = in_flight == 0 && handle_users == 0;
+        if (device_ref)
+            libusb_unref_device(device);
+        device_ref = false; //From now on the open handle keeps the device alive
+        device = nullptr;
+        guard.unlock();
+        if (dead && can_close)
+            libusb_close(dead);
+
+        libusb_device_handle *fresh = nullptr;
+        guard.lock();
+        while (!link_stopping)
+        {
+            device_arrived = false;
+            guard.unlock();
+            fresh = reopen();
+            guard.lock();
+            if (fresh)
+                break;
+            link_cv.wait_for(guard, std::chrono::milliseconds(reconnect_poll_ms), [this]() { return link_stopping || device_arrived; });
+        }
+        if (fresh == nullptr)
+            return;
+
+        uint64_t now = cb_now_ns();
+        device = libusb_get_device(fresh);
+        link_lost = false;
+        link_stats.connected = true;
+        link_stats.reconnects++;
+        link_stats.last_outage_ns = now - lost_ns;
+        link_stats.max_outage_ns = std::max(link_stats.max_outage_ns, link_stats.last_outage_ns);
+        link_stats.last_reconnect_ns = arrived_ns != 0 ? now - arrived_ns : 0;
+        guard.unlock();
+        handle = fresh;
+        {
+            std::lock_guard<std::mutex> handler_guard(handler_lock);
+            if (link_handler)
+                link_handler(true);
+        }
+        guard.lock();
+    }
+}
+
+CBBufferBlock ChassisLibusbTransport::alloc_buffers(size_t size, bool device_memory)
+{
+    if (device_memory)
+    {
+        HandleRef ref(*this);
+        unsigned char *data = ref.get() ? libusb_dev_mem_alloc(ref.get(), size) : nullptr;
+        if (data)
+        {
+            CBBufferBlock block;
+            block.data = data;
+            block.size = size;
+            block.backend = ref.get();
+            return block;
+        }
+    }
+    return ChassisTransport::alloc_buffers(size, false);
+}
+
+void ChassisLibusbTransport::free_buffers(CBBufferBlock &block)
+{
+    if (block.backend == nullptr)
+        return ChassisTransport::free_buffers(block);
+    HandleRef ref(*this);
+    if (ref.get() == block.backend)
+        libusb_dev_mem_free(ref.get(), block.data, block.size);
+    else
+    {
+        //The handle was replaced by a reconnect, the mapping outlives it and is released directly
+        #ifdef __linux__
+        munmap(block.data, block.size);
+        #endif
+    }
+    block = CBBufferBlock();
+}
+
+void ChassisLibusbTransport::set_link_handler(CBLinkHandler handler)
+{
+    std::lock_guard<std::mutex> guard(handler_lock);
+    link_handler = std::move(handler);
+}
+
+CBLinkStats ChassisLibusbTransport::get_link_stats()
+{
+    std::lock_guard<std::mutex> guard(link_lock);
+    return link_stats;
+}
+
+libusb_error ChassisLibusbTransport::status_to_error(libusb_transfer_status status)
+{
+    switch (status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED:
+            return LIBUSB_SUCCESS;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return LIBUSB_ERROR_INTERRUPTED;
+        case LIBUSB_TRANSFER_STALL:
+            return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            return LIBUSB_ERROR_OVERFLOW;
+        default:
+            return LIBUSB_ERROR_IO;
+    }
+}
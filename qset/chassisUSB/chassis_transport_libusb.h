@@ -0,0 +1,178 @@
+#ifndef CHASSIS_TRANSPORT_LIBUSB_H
+#define CHASSIS_TRANSPORT_LIBUSB_H
+
+#include "chassis_transport.h"
+#include "dependencies/usb_dev.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file chassis_transport_libusb.h
+ * @author Kian Cossettini
+ * @brief QSET Chassis Board libusb Transport
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+/**
+ * @brief Requests completed without a transfer (`ChassisTransport::complete_later()`).
+ *
+ * Run by whoever handles the events of the libusb context: the transport itself, or the event
+ * thread of the `ChassisBoardManager` sharing its context.
+ */
+struct CBPostedCompletions
+{
+    std::mutex lock;
+    std::vector<std::pair<CBTransportRequest*, libusb_error>> entries;
+
+    void post(CBTransportRequest *request, libusb_error err);
+    //Completes everything posted so far, returns whether there was anything
+    bool run();
+};
+
+/**
+ * @class ChassisLibusbTransport
+ * @brief Transport to the physical chassis board (`VENDOR_ID`:`DEVICE_ID`) through libusb.
+ *
+ * This is the default transport of `ChassisBoard`. It honours the `CHASSIS_KDBYPASS_*` flags
+ * when claiming interfaces.
+ *
+ * Once the interfaces are claimed, a background thread watches the link. When the board goes away
+ * (libusb hotplug event, or any transfer failing with `LIBUSB_ERROR_NO_DEVICE`), calls fail fast
+ * with `LIBUSB_ERROR_NO_DEVICE` instead of timing out, and the board is reopened and every claimed
+ * interface claimed again as soon as it enumerates. Without hotplug support the device list is
+ * polled instead (`reconnect_poll_ms`).
+ *
+ * A transport created by `ChassisBoardManager` is bound to one board (reconnects match its serial
+ * number, or its bus path if it has none) and runs on the manager's context and event thread.
+ *
+ * `open()` opens the board right away, looking first at the bus path it was given (no descriptor read
+ * for the other devices) and then for any `B_VID`:`B_PID` device. Every step up to
+ * the last claimed interface is timed and a failure names its step, see `get_startup_stats()`.
+ */
+class ChassisLibusbTransport : public ChassisTransport
+{
+    public:
+        static constexpr uint16_t B_VID = 0xFFFE;
+        static constexpr uint16_t B_PID = 0xD415;
+
+    private:
+        libusb_context *ctx = nullptr;
+        bool shared_ctx = false;  //Context owned by a `ChassisBoardManager`
+        bool device_ref = false;  //`device` holds a reference of its own
+        std::string serial;       //Identity of the board for reconnects, empty = any board
+        std::string path;
+        libusb_device *device = nullptr; 
+        std::atomic<libusb_device_handle*> handle{nullptr};
+
+        //Calls currently using `handle`, the link monitor only closes a handle nobody uses
+        std::atomic<int> handle_users{0};
+        class HandleRef
+        {
+            public:
+                explicit HandleRef(ChassisLibusbTransport &owner);
+                ~HandleRef();
+                libusb_device_handle *get() const { return handle; }
+            private:
+                ChassisLibusbTransport &owner;
+                libusb_device_handle *handle;
+        };
+        //Asynchronous transfers submitted and not completed yet
+        std::atomic<int> in_flight{0};
+        //Interfaces claimed through `claim_interface()`, claimed again after a reconnect
+        std::vector<int> extra_interfaces;
+
+        //Link monitor, everything below is guarded by `link_lock`
+        std::mutex link_lock;
+        std::condition_variable link_cv;
+        std::thread link_thread;
+        bool link_stopping = false;
+        bool link_lost = false;
+        bool device_arrived = false;
+        uint64_t lost_ns = 0;
+        uint64_t arrived_ns = 0;
+        CBLinkStats link_stats;
+        bool hotplug_registered = false;
+        libusb_hotplug_callback_handle hotplug_handle;
+
+        CBPostedCompletions own_posted;
+        CBPostedCompletions *posted = &own_posted;
+
+        //Serialises calls of the link handler with `set_link_handler()`
+        std::mutex handler_lock;
+        CBLinkHandler link_handler;
+
+        //Written by `open()` and `claim_interfaces()` only
+        CBStartupStats startup;
+        uint64_t startup_begin_ns = 0;
+        //Records the end of `phase` (started at `since`), returns `err`
+        libusb_error end_phase(eCBStartupPhase phase, uint64_t since, libusb_error err);
+        libusb_device *find_device(libusb_device **devices, ssize_t count);
+
+        static void LIBUSB_CALL transfer_cb(libusb_transfer *transfer);
+        static int LIBUSB_CALL hotplug_cb(libusb_context *ctx, libusb_device *dev, libusb_hotplug_event event, void *user_data);
+        void start_link_monitor();
+        void report_lost();
+        void link_loop();
+        libusb_device_handle *reopen();
+
+    public:
+        ChassisLibusbTransport() = default;
+        /**
+         * @brief Transport that tries the board at `bus_path` first (e.g. `CBStartupStats::bus_path` of
+         *        an earlier start) and stays bound to that port for reconnects.
+         *
+         * Falls back to any board when nothing matching is plugged in there.
+         */
+        explicit ChassisLibusbTransport(const std::string &bus_path);
+        /**
+         * @brief Transport bound to `device` on a context owned by the caller (see `ChassisBoardManager`).
+         *
+         * `open()` only verifies the device, the context outlives the transport and its events are
+         * handled by the caller, which also runs `posted` after handling them.
+         */
+        ChassisLibusbTransport(libusb_context *context, libusb_device *device, const std::string &serial,
+                               CBPostedCompletions *posted);
+        ChassisLibusbTransport(const ChassisLibusbTransport&) = delete;
+        ChassisLibusbTransport& operator=(const ChassisLibusbTransport&) = delete;
+        ~ChassisLibusbTransport() override;
+
+        libusb_error open(libusb_log_level log_lvl) override;
+        libusb_error claim_interfaces() override;
+        libusb_error claim_interface(int interface_num) override;
+        void release_interface(int interface_num) override;
+        libusb_error transfer(uint8_t endpoint, unsigned char *data, int length, int *transferred, unsigned int timeout) override;
+        libusb_error prepare(CBTransportRequest *request) override;
+        void release(CBTransportRequest *request) override;
+        libusb_error submit(CBTransportRequest *request) override;
+        void cancel(CBTransportRequest *request) override;
+        void complete_later(CBTransportRequest *request, libusb_error err) override;
+        void handle_events(int timeout_us) override;
+        void wake() override;
+        bool shared_events() const override;
+        void set_link_handler(CBLinkHandler handler) override;
+        CBLinkStats get_link_stats() override;
+        CBStartupStats get_startup_stats() override;
+        //Uses `libusb_dev_mem_alloc()` (zero-copy usbfs memory) when asked and the kernel supports it
+        CBBufferBlock alloc_buffers(size_t size, bool device_memory) override;
+        void free_buffers(CBBufferBlock &block) override;
+
+        //Device list poll interval while the board is missing (hotplug events usually arrive first)
+        static constexpr int reconnect_poll_ms = 20;
+
+        //Translates a libusb transfer status into the matching libusb error code
+        static libusb_error status_to_error(libusb_transfer_status status);
+        //Serial number string of an open device, empty if it has none
+        static std::string read_serial(libusb_device_handle *handle);
+        //Physical location of a device as "bus-port.port...", stable across replugs into the same port
+        static std::string bus_path(libusb_device *device);
+};
+
+#endif
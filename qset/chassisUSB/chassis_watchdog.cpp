@@ -0,0 +1,174 @@
+#include "chassis_watchdog.h"
+#include "chassis_clock.h"
+#include "dependencies/usb_chassis_defs.h"
+#include <cerrno>
+
+ChassisWatchdog::~ChassisWatchdog()
+{
+    stop();
+}
+
+int ChassisWatchdog::start(const CBWatchdogConfig &config, CBFailsafe failsafe, CBWatchdogHandler handler)
+{
+    if (loop && loop->is_running())
+        return EBUSY;
+    if (!(config.check_rate_hz > 0) || !failsafe)
+        return EINVAL;
+    this->config = config;
+    this->failsafe = std::move(failsafe);
+    this->handler = std::move(handler);
+    uint64_t now = cb_now_ns();
+    last_write_ns = now;
+    last_read_ns = now;
+    status_code = eDrvOK;
+    tripped = false;
+    failsafe_done = false;
+    reason = eCBTripNone;
+    gate = false;
+    resend = false;
+    blocked = 0;
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        stats = {};
+    }
+
+    loop.reset(new ChassisLoopScheduler(config.check_rate_hz));
+    loop->set_realtime(config.priority);
+    loop->set_cpu(config.cpu);
+    return loop->start([this](uint64_t) { check(); });
+}
+
+void ChassisWatchdog::stop()
+{
+    if (loop)
+        loop->stop();
+    gate = false;
+}
+
+bool ChassisWatchdog::is_running() const
+{
+    return loop && loop->is_running();
+}
+
+void ChassisWatchdog::note_write(uint64_t now_ns)
+{
+    if (sending.load(std::memory_order_relaxed))
+        return;
+    last_write_ns.store(now_ns, std::memory_order_relaxed);
+    if (gate.load(std::memory_order_relaxed))
+        resend.store(true, std::memory_order_relaxed);
+}
+
+void ChassisWatchdog::note_blocked_write(uint64_t now_ns)
+{
+    last_write_ns.store(now_ns, std::memory_order_relaxed);
+    blocked.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ChassisWatchdog::is_tripped() const
+{
+    return gate.load(std::memory_order_relaxed);
+}
+
+void ChassisWatchdog::note_read(uint64_t now_ns)
+{
+    last_read_ns.store(now_ns, std::memory_order_relaxed);
+}
+
+void ChassisWatchdog::note_status(uint8_t code, uint64_t now_ns)
+{
+    bool bad = code == eDrvStall || code == eDrvMtrFail;
+    //Keep the time the status first went bad, the reaction is measured from there
+    if (bad && status_code.exchange(code, std::memory_order_relaxed) != code)
+        status_ns.store(now_ns, std::memory_order_relaxed);
+    else if (!bad)
+        status_code.store(code, std::memory_order_relaxed);
+}
+
+CBWatchdogStats ChassisWatchdog::get_stats()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    CBWatchdogStats result = stats;
+    result.blocked_writes = blocked.load(std::memory_order_relaxed);
+    return result;
+}
+
+eCBWatchdogTrip ChassisWatchdog::evaluate(uint64_t now_ns, uint64_t &missed_at) const
+{
+    if (config.trip_on_status)
+    {
+        uint8_t code = status_code.load(std::memory_order_relaxed);
+        if (code == eDrvStall || code == eDrvMtrFail)
+        {
+            missed_at = status_ns.load(std::memory_order_relaxed);
+            return eCBTripStatus;
+        }
+    }
+    if (config.write_deadline_ms)
+    {
+        uint64_t deadline = last_write_ns.load(std::memory_order_relaxed) + config.write_deadline_ms * 1000000ull;
+        if (now_ns > deadline)
+        {
+            missed_at = deadline;
+            return eCBTripWrite;
+        }
+    }
+    if (config.read_deadline_ms)
+    {
+        uint64_t deadline = last_read_ns.load(std::memory_order_relaxed) + config.read_deadline_ms * 1000000ull;
+        if (now_ns > deadline)
+        {
+            missed_at = deadline;
+            return eCBTripRead;
+        }
+    }
+    return eCBTripNone;
+}
+
+void ChassisWatchdog::check()
+{
+    uint64_t missed_at = 0;
+    eCBWatchdogTrip missed = evaluate(cb_now_ns(), missed_at);
+    if (missed == eCBTripNone)
+    {
+        if (tripped)
+        {
+            tripped = false;
+            gate = false;
+            resend = false;
+            std::lock_guard<std::mutex> guard(stats_lock);
+            stats.tripped = false;
+        }
+        return;
+    }
+    if (!tripped)
+    {
+        //Writers are stopped before the failsafe goes out
+        gate = true;
+        tripped = true;
+        failsafe_done = false;
+        reason = missed;
+        missed_at_ns = missed_at;
+        std::lock_guard<std::mutex> guard(stats_lock);
+        stats.trips++;
+        stats.last_trip = missed;
+        stats.tripped = true;
+    }
+    if (failsafe_done && !resend.exchange(false))
+        return;
+
+    sending = true;
+    libusb_error err = failsafe();
+    sending = false;
+    uint64_t done_ns = cb_now_ns();
+    failsafe_done = err == LIBUSB_SUCCESS;
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        if (err != LIBUSB_SUCCESS)
+            stats.failsafe_errors++;
+        else if (done_ns > missed_at_ns && done_ns - missed_at_ns > stats.max_reaction_ns)
+            stats.max_reaction_ns = done_ns - missed_at_ns;
+    }
+    if (handler)
+        handler(reason, err);
+}
@@ -0,0 +1,132 @@
+#ifndef CHASSIS_WATCHDOG_H
+#define CHASSIS_WATCHDOG_H
+
+#include "chassis_scheduler.h"
+#include <libusb-1.0/libusb.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/**
+ * @file chassis_watchdog.h
+ * @author Kian Cossettini
+ * @brief Host side drive motor watchdog
+ * @version 0.1
+ * @date 2025-03-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+//Why the watchdog tripped
+enum eCBWatchdogTrip
+{
+    eCBTripNone,
+    eCBTripWrite,  //No successful drive write within `write_deadline_ms`
+    eCBTripRead,   //No successful drive read within `read_deadline_ms`
+    eCBTripStatus  //The drive board reported `eDrvStall` or `eDrvMtrFail`
+};
+
+struct CBWatchdogConfig
+{
+    //Longest time without a successful drive write (or `feed_watchdog()`), 0 = not checked
+    uint32_t write_deadline_ms = 50;
+    //Longest time without a successful drive status read, 0 = not checked
+    uint32_t read_deadline_ms = 0;
+    //Trip on a stalled or failed drive status, from reads and notifications
+    bool trip_on_status = true;
+    //Deadline checks per second, the reaction time is one check period plus the failsafe transfers
+    double check_rate_hz = 1000;
+    //`SCHED_FIFO` priority of the watchdog thread (0 = default policy) and CPU to pin it to (-1 = none)
+    int priority = 0;
+    int cpu = -1;
+    //Timeout of each failsafe transfer
+    unsigned int failsafe_timeout_ms = 5;
+};
+
+struct CBWatchdogStats
+{
+    uint64_t trips;
+    eCBWatchdogTrip last_trip;
+    bool tripped;              //Still tripped, clears once every deadline is met and the status is OK again
+    uint64_t failsafe_errors;  //Failsafe sends that failed (retried every check until one succeeds)
+    uint64_t max_reaction_ns;  //Worst time from the missed deadline (or bad status) to the motors disabled
+    uint64_t blocked_writes;   //Drive writes refused while tripped
+};
+
+//Called on the watchdog thread once the failsafe was sent (or failed)
+using CBWatchdogHandler = std::function<void(eCBWatchdogTrip reason, libusb_error failsafe_err)>;
+
+/**
+ * @class ChassisWatchdog
+ * @brief Checks the drive traffic deadlines on its own thread and runs a failsafe when one is missed.
+ *
+ * The board reports every successful drive write and read and every drive status (`note_*()`, a
+ * relaxed atomic store each). The check loop runs on a `ChassisLoopScheduler`, so it keeps its rate
+ * however late the application's own loop is. On the first missed check it calls the failsafe until it
+ * succeeds, then stays tripped until the traffic is back. Used by `ChassisBoard::start_watchdog()`.
+ *
+ * While tripped the board refuses drive writes (`is_tripped()`), reporting each refused one with
+ * `note_blocked_write()`. A refused write still proves the control loop is alive, so a write deadline trip
+ * clears at the next check, while a status trip holds until the drive board reports a good status again.
+ * A drive write that slipped past the check as the watchdog tripped makes it send the failsafe again.
+ */
+class ChassisWatchdog
+{
+    public:
+        //Sends the disable packets, returns the first error
+        using CBFailsafe = std::function<libusb_error()>;
+
+        ChassisWatchdog() = default;
+        ChassisWatchdog(const ChassisWatchdog&) = delete;
+        ChassisWatchdog& operator=(const ChassisWatchdog&) = delete;
+        ~ChassisWatchdog();
+
+        /**
+         * @brief Starts checking. The deadlines count from the call.
+         *
+         * @return 0 on success, `EBUSY` if already running, `EINVAL` for a non-positive check rate,
+         *         otherwise the error of `ChassisLoopScheduler::start()`.
+         */
+        int start(const CBWatchdogConfig &config, CBFailsafe failsafe, CBWatchdogHandler handler);
+        void stop();
+        bool is_running() const;
+
+        void note_write(uint64_t now_ns);
+        void note_read(uint64_t now_ns);
+        void note_status(uint8_t code, uint64_t now_ns);
+        void note_blocked_write(uint64_t now_ns);
+        //Drive writes must not be sent
+        bool is_tripped() const;
+
+        CBWatchdogStats get_stats();
+
+    private:
+        CBWatchdogConfig config;
+        CBFailsafe failsafe;
+        CBWatchdogHandler handler;
+        std::unique_ptr<ChassisLoopScheduler> loop;
+        std::atomic<uint64_t> last_write_ns{0};
+        std::atomic<uint64_t> last_read_ns{0};
+        std::atomic<uint8_t> status_code{0};
+        std::atomic<uint64_t> status_ns{0};  //When the current bad status arrived
+        std::atomic<bool> sending{false};    //The failsafe's own writes are not traffic
+        std::atomic<bool> gate{false};       //Tripped, as seen by the writers
+        std::atomic<bool> resend{false};     //A drive write went out while tripped
+        std::atomic<uint64_t> blocked{0};
+        //Owned by the check loop
+        bool tripped = false;
+        bool failsafe_done = false;
+        eCBWatchdogTrip reason = eCBTripNone;
+        uint64_t missed_at_ns = 0;
+        std::mutex stats_lock;
+        CBWatchdogStats stats = {};
+
+        void check();
+        //First missed condition and when it was missed, `eCBTripNone` if all is well
+        eCBWatchdogTrip evaluate(uint64_t now_ns, uint64_t &missed_at) const;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "chassis_board.h"
+#include "chassis_daemon.h"
+#include "chassis_mock_board.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+
+/*
+ * Chassis daemon. Owns the board and shares it with every local process through shared memory
+ * (see ChassisShmClient in chassis_shm.h).
+ *
+ * chassisd [--mock] [--name NAME] [--rate HZ] [--depth N]
+ *
+ *   --mock   Serve the simulated board instead of the real one
+ *   --name   Shared-memory name (default /qset_chassis)
+ *   --rate   Status poll and command rate (default 500)
+ *   --depth  Transfers kept per endpoint by the asynchronous engine (default 4)
+ */
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int)
+{
+    stopping = 1;
+}
+
+int main(int argc, char **argv)
+{
+    bool mock_board = false;
+    const char *name = cb_shm_default_name;
+    double rate_hz = 500;
+    int depth = 4;
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--mock") == 0)
+            mock_board = true;
+        else if (strcmp(argv[i], "--name") == 0 && has_value)
+            name = argv[++i];
+        else if (strcmp(argv[i], "--rate") == 0 && has_value)
+            rate_hz = atof(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && has_value)
+            depth = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--mock] [--name NAME] [--rate HZ] [--depth N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    ChassisMockBoard mock;
+    std::unique_ptr<ChassisBoard> chassis = mock_board ? std::make_unique<ChassisBoard>(mock) : std::make_unique<ChassisBoard>();
+    libusb_error err = chassis->initialize(LIBUSB_LOG_LEVEL_NONE);
+    if (err == LIBUSB_SUCCESS)
+        err = chassis->claimInterfaces();
+    if (err == LIBUSB_SUCCESS)
+        err = chassis->start_async(depth);
+    if (err != LIBUSB_SUCCESS)
+    {
+        fprintf(stderr, "chassis setup failed: %s\n", libusb_error_name(err));
+        return 1;
+    }
+
+    ChassisDaemon daemon(*chassis);
+    int start_err = daemon.start(name, rate_hz);
+    if (start_err != 0)
+    {
+        fprintf(stderr, "daemon start failed: %s\n", strerror(start_err));
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    fprintf(stderr, "serving chassis on %s at %.0f Hz\n", name, rate_hz);
+    while (!stopping)
+        pause();
+
+    daemon.stop();
+    CBDaemonStats stats = daemon.get_stats();
+    fprintf(stderr, "cycles %llu, commands %llu, dropped %llu, published %llu\n",
+            (unsigned long long)stats.cycles, (unsigned long long)stats.commands,
+            (unsigned long long)stats.commands_dropped, (unsigned long long)stats.published);
+    return 0;
+}